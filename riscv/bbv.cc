@@ -0,0 +1,67 @@
+// See LICENSE for license details.
+
+#include "bbv.h"
+#include <errno.h>
+#include <string.h>
+#include <cinttypes>
+#include <stdexcept>
+
+bbv_t::bbv_t(const std::string& path, reg_t interval)
+  : interval(interval), block_start(0), block_insns(0), next_pc(reg_t(-1)),
+    interval_insns(0)
+{
+  for (auto& r : recent)
+    r.pc = reg_t(-1);
+  out = fopen(path.c_str(), "w");
+  if (!out)
+    throw std::runtime_error("couldn't open " + path + ": " + strerror(errno));
+}
+
+bbv_t::~bbv_t()
+{
+  end_block(0);
+  if (interval_insns)
+    end_interval();
+  fclose(out);
+}
+
+void bbv_t::end_block(reg_t next_start)
+{
+  if (block_insns) {
+    size_t id = block_id(block_start);
+    if (counts[id] == 0)
+      executed.push_back(id);
+    counts[id] += block_insns;
+    interval_insns += block_insns;
+    if (interval_insns >= interval)
+      end_interval();
+  }
+
+  block_start = next_start;
+  block_insns = 0;
+}
+
+size_t bbv_t::block_id(reg_t pc)
+{
+  recent_t& r = recent[(pc >> 1) % RECENT_BLOCKS];
+  if (r.pc != pc) {
+    auto it = ids.emplace(pc, counts.size()).first;
+    if (it->second == counts.size())
+      counts.push_back(0);
+    r.pc = pc;
+    r.id = it->second;
+  }
+  return r.id;
+}
+
+void bbv_t::end_interval()
+{
+  fputc('T', out);
+  for (size_t id : executed) {
+    fprintf(out, ":%zu:%" PRIu64 " ", id + 1, counts[id]);
+    counts[id] = 0;
+  }
+  fputc('\n', out);
+  executed.clear();
+  interval_insns = 0;
+}
@@ -0,0 +1,65 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_BBV_H
+#define _RISCV_BBV_H
+
+#include "decode.h"
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Counts the instructions each basic block of one hart executes, and
+// writes them out every interval instructions as a SimPoint basic block
+// vector, one "T:id:count :id:count ..." line per interval.  A block is the
+// run of instructions from where control arrives to the next taken branch,
+// jump, trap or interrupt, and is identified by its first pc.  Intervals
+// end at the first block boundary once they hold interval instructions.
+class bbv_t
+{
+ public:
+  // throws std::runtime_error if path can't be opened
+  bbv_t(const std::string& path, reg_t interval);
+  // writes the last, partial interval
+  ~bbv_t();
+
+  // before the instruction at pc executes
+  void fetch(reg_t pc)
+  {
+    if (unlikely(pc != next_pc))
+      end_block(pc);
+  }
+
+  // once insns more instructions have retired, the last of them falling
+  // through to next_pc
+  void retire(reg_t insns, reg_t next_pc)
+  {
+    block_insns += insns;
+    this->next_pc = next_pc;
+  }
+
+ private:
+  void end_block(reg_t next_start);
+  size_t block_id(reg_t pc);
+  void end_interval();
+
+  FILE* out;
+  reg_t interval;
+  reg_t block_start;
+  reg_t block_insns;
+  reg_t next_pc;
+  reg_t interval_insns;
+  // block ids, less one, by first pc, with the most recent in front
+  static const size_t RECENT_BLOCKS = 1024;
+  struct recent_t {
+    reg_t pc;
+    size_t id;
+  } recent[RECENT_BLOCKS];
+  std::unordered_map<reg_t, size_t> ids;
+  // instructions each block has executed this interval
+  std::vector<uint64_t> counts;
+  // the blocks executed this interval, in order of first execution
+  std::vector<size_t> executed;
+};
+
+#endif
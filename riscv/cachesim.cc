@@ -1,23 +1,150 @@
 // See LICENSE for license details.
 
 #include "cachesim.h"
+#include "coherence.h"
+#include "missprof.h"
 #include "common.h"
+#include "vector_kernels.h"
 #include <cstdlib>
 #include <iostream>
 #include <iomanip>
 
-cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char* _name)
+namespace {
+
+class random_policy_t : public repl_policy_t
+{
+ public:
+  random_policy_t(size_t ways) : ways(ways) {}
+  repl_policy_t* clone() const { return new random_policy_t(*this); }
+  size_t victim(size_t set) { return lfsr.next() % ways; }
+  void hit(size_t set, size_t way) {}
+  void fill(size_t set, size_t way) {}
+ private:
+  lfsr_t lfsr;
+  size_t ways;
+};
+
+// Each line is stamped with the time of its last use, and invalid lines
+// with 0, so that they are replaced first.
+class lru_policy_t : public repl_policy_t
+{
+ public:
+  lru_policy_t(size_t sets, size_t ways) : ways(ways), stamps(sets * ways), now(0) {}
+  repl_policy_t* clone() const { return new lru_policy_t(*this); }
+  size_t victim(size_t set)
+  {
+    const uint64_t* s = &stamps[set * ways];
+    size_t way = 0;
+    for (size_t i = 1; i < ways; i++)
+      if (s[i] < s[way])
+        way = i;
+    return way;
+  }
+  void hit(size_t set, size_t way) { stamps[set * ways + way] = ++now; }
+  void fill(size_t set, size_t way) { hit(set, way); }
+  void invalidate(size_t set, size_t way) { stamps[set * ways + way] = 0; }
+ private:
+  size_t ways;
+  std::vector<uint64_t> stamps;
+  uint64_t now;
+};
+
+// A binary tree per set, whose nodes 1 to ways - 1 each point to the half
+// of their ways that holds the victim: 0 to the lower half, 1 to the upper.
+class plru_policy_t : public repl_policy_t
+{
+ public:
+  plru_policy_t(size_t sets, size_t ways) : ways(ways), nodes(sets * ways) {}
+  repl_policy_t* clone() const { return new plru_policy_t(*this); }
+  size_t victim(size_t set)
+  {
+    const uint8_t* t = &nodes[set * ways];
+    size_t way = 0;
+    for (size_t node = 1, half = ways / 2; half; half /= 2) {
+      if (t[node])
+        way |= half;
+      node = 2 * node + t[node];
+    }
+    return way;
+  }
+  void hit(size_t set, size_t way) { point(set, way, false); }
+  void fill(size_t set, size_t way) { point(set, way, false); }
+  void invalidate(size_t set, size_t way) { point(set, way, true); }
+ private:
+  // make the path to way point toward it, or away from it
+  void point(size_t set, size_t way, bool toward)
+  {
+    uint8_t* t = &nodes[set * ways];
+    for (size_t node = 1, half = ways / 2; half; half /= 2) {
+      uint8_t upper = (way & half) != 0;
+      t[node] = toward ? upper : !upper;
+      node = 2 * node + upper;
+    }
+  }
+
+  size_t ways;
+  std::vector<uint8_t> nodes;
+};
+
+#define SRRIP_MAX_RRPV 3
+
+// Lines are inserted with a long re-reference prediction, 2, promoted to
+// 0 on a hit, and aged until one reaches 3, the most distant, to be
+// replaced.  Invalid lines are at 3.
+class srrip_policy_t : public repl_policy_t
+{
+ public:
+  srrip_policy_t(size_t sets, size_t ways) : ways(ways), rrpv(sets * ways, SRRIP_MAX_RRPV) {}
+  repl_policy_t* clone() const { return new srrip_policy_t(*this); }
+  size_t victim(size_t set)
+  {
+    uint8_t* r = &rrpv[set * ways];
+    for (;;) {
+      for (size_t i = 0; i < ways; i++)
+        if (r[i] == SRRIP_MAX_RRPV)
+          return i;
+      for (size_t i = 0; i < ways; i++)
+        r[i]++;
+    }
+  }
+  void hit(size_t set, size_t way) { rrpv[set * ways + way] = 0; }
+  void fill(size_t set, size_t way) { rrpv[set * ways + way] = SRRIP_MAX_RRPV - 1; }
+  void invalidate(size_t set, size_t way) { rrpv[set * ways + way] = SRRIP_MAX_RRPV; }
+ private:
+  size_t ways;
+  std::vector<uint8_t> rrpv;
+};
+
+}
+
+repl_policy_t* repl_policy_t::construct(const std::string& name, size_t sets, size_t ways)
+{
+  if (name == "random")
+    return new random_policy_t(ways);
+  if (name == "lru")
+    return new lru_policy_t(sets, ways);
+  if (name == "plru" && (ways & (ways - 1)) == 0)
+    return new plru_policy_t(sets, ways);
+  if (name == "srrip")
+    return new srrip_policy_t(sets, ways);
+  return NULL;
+}
+
+cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char* _name,
+                         const std::string& _policy)
 : sets(_sets), ways(_ways), linesz(_linesz), name(_name), log(false)
 {
-  init();
+  init(_policy);
 }
 
 static void help()
 {
   std::cerr << "Cache configurations must be of the form" << std::endl;
-  std::cerr << "  sets:ways:blocksize" << std::endl;
+  std::cerr << "  sets:ways:blocksize[:policy]" << std::endl;
   std::cerr << "where sets, ways, and blocksize are positive integers, with" << std::endl;
-  std::cerr << "sets and blocksize both powers of two and blocksize at least 8." << std::endl;
+  std::cerr << "sets and blocksize both powers of two and blocksize at least 8," << std::endl;
+  std::cerr << "and policy is random (the default), lru, plru, with ways a power" << std::endl;
+  std::cerr << "of two, or srrip." << std::endl;
   exit(1);
 }
 
@@ -27,28 +154,37 @@ cache_sim_t* cache_sim_t::construct(const char* config, const char* name)
   if (!wp++) help();
   const char* bp = strchr(wp, ':');
   if (!bp++) help();
+  const char* pp = strchr(bp, ':');
+  std::string policy = pp ? pp + 1 : "random";
 
   size_t sets = atoi(std::string(config, wp).c_str());
   size_t ways = atoi(std::string(wp, bp).c_str());
   size_t linesz = atoi(bp);
 
-  if (ways > 4 /* empirical */ && sets == 1)
-    return new fa_cache_sim_t(ways, linesz, name);
-  return new cache_sim_t(sets, ways, linesz, name);
+  if (ways > 4 /* empirical */ && sets == 1) {
+    if (policy == "random")
+      return new fa_cache_sim_t(ways, linesz, name);
+    if (policy == "lru")
+      return new fa_lru_cache_sim_t(ways, linesz, name);
+  }
+  return new cache_sim_t(sets, ways, linesz, name, policy);
 }
 
-void cache_sim_t::init()
+void cache_sim_t::init(const std::string& policy_name)
 {
   if(sets == 0 || (sets & (sets-1)))
     help();
   if(linesz < 8 || (linesz & (linesz-1)))
     help();
+  if(ways == 0 || !(policy = repl_policy_t::construct(policy_name, sets, ways)))
+    help();
 
   idx_shift = 0;
   for (size_t x = linesz; x>1; x >>= 1)
     idx_shift++;
 
   tags = new uint64_t[sets*ways]();
+  flags = new uint64_t[sets*ways]();
   read_accesses = 0;
   read_misses = 0;
   bytes_read = 0;
@@ -58,20 +194,29 @@ void cache_sim_t::init()
   writebacks = 0;
 
   miss_handler = NULL;
+  coherence = NULL;
+  coherence_id = 0;
+  inclusive_of = NULL;
+  profile = NULL;
 }
 
 cache_sim_t::cache_sim_t(const cache_sim_t& rhs)
- : sets(rhs.sets), ways(rhs.ways), linesz(rhs.linesz),
-   idx_shift(rhs.idx_shift), name(rhs.name), log(false)
+ : policy(rhs.policy->clone()), coherence(NULL), coherence_id(0),
+   inclusive_of(NULL), profile(NULL), sets(rhs.sets), ways(rhs.ways),
+   linesz(rhs.linesz), idx_shift(rhs.idx_shift), name(rhs.name), log(false)
 {
   tags = new uint64_t[sets*ways];
   memcpy(tags, rhs.tags, sets*ways*sizeof(uint64_t));
+  flags = new uint64_t[sets*ways];
+  memcpy(flags, rhs.flags, sets*ways*sizeof(uint64_t));
 }
 
 cache_sim_t::~cache_sim_t()
 {
   print_stats();
   delete [] tags;
+  delete [] flags;
+  delete policy;
 }
 
 void cache_sim_t::print_stats()
@@ -102,12 +247,26 @@ void cache_sim_t::print_stats()
 
 uint64_t* cache_sim_t::check_tag(uint64_t addr)
 {
+  typedef vk_vec_t<uint64_t>::type tag_vec_t;
+  const size_t lanes = vk_vec_t<uint64_t>::lanes;
+
   size_t idx = (addr >> idx_shift) & (sets-1);
-  size_t tag = (addr >> idx_shift) | VALID;
+  uint64_t tag = (addr >> idx_shift) | VALID;
+  uint64_t* set = &tags[idx*ways];
 
-  for (size_t i = 0; i < ways; i++)
-    if (tag == (tags[idx*ways + i] & ~DIRTY))
-      return &tags[idx*ways + i];
+  size_t i = 0;
+  tag_vec_t key = tag_vec_t{} + tag;
+  for (; i + lanes <= ways; i += lanes) {
+    tag_vec_t eq = (tag_vec_t)(*(const tag_vec_t*)&set[i] == key);
+    uint64_t any = 0;
+    for (size_t j = 0; j < lanes; j++)
+      any |= eq[j];
+    if (any)
+      break;
+  }
+  for (; i < ways; i++)
+    if (set[i] == tag)
+      return &set[i];
 
   return NULL;
 }
@@ -115,12 +274,66 @@ uint64_t* cache_sim_t::check_tag(uint64_t addr)
 uint64_t cache_sim_t::victimize(uint64_t addr)
 {
   size_t idx = (addr >> idx_shift) & (sets-1);
-  size_t way = lfsr.next() % ways;
-  uint64_t victim = tags[idx*ways + way];
+  size_t way = policy->victim(idx);
+  uint64_t victim = tags[idx*ways + way] | flags[idx*ways + way];
   tags[idx*ways + way] = (addr >> idx_shift) | VALID;
+  flags[idx*ways + way] = 0;
+  policy->fill(idx, way);
   return victim;
 }
 
+void cache_sim_t::touch(uint64_t* line)
+{
+  size_t i = line - tags;
+  policy->hit(i / ways, i % ways);
+}
+
+void cache_sim_t::drop(uint64_t* line)
+{
+  size_t i = line - tags;
+  *line = 0;
+  flags[i] = 0;
+  policy->invalidate(i / ways, i % ways);
+}
+
+void cache_sim_t::set_coherence(coherence_t* dir)
+{
+  coherence = dir;
+  coherence_id = dir->add_cache(this);
+}
+
+bool cache_sim_t::invalidate(uint64_t addr, bool write_back)
+{
+  uint64_t* line = check_tag(addr);
+  if (!line)
+    return false;
+
+  bool dirty = get_flags(line) & DIRTY;
+  if (dirty && write_back) {
+    if (miss_handler)
+      miss_handler->access(addr & ~(linesz-1), linesz, true);
+    writebacks++;
+  }
+  drop(line);
+  return dirty;
+}
+
+bool cache_sim_t::share(uint64_t addr)
+{
+  uint64_t* line = check_tag(addr);
+  if (!line)
+    return false;
+
+  bool dirty = get_flags(line) & DIRTY;
+  if (dirty) {
+    if (miss_handler)
+      miss_handler->access(addr & ~(linesz-1), linesz, true);
+    writebacks++;
+  }
+  set_flags(line, SHARED);
+  return dirty;
+}
+
 void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
 {
   store ? write_accesses++ : read_accesses++;
@@ -129,12 +342,18 @@ void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
   uint64_t* hit_way = check_tag(addr);
   if (likely(hit_way != NULL))
   {
-    if (store)
-      *hit_way |= DIRTY;
+    touch(hit_way);
+    if (store) {
+      if (unlikely(get_flags(hit_way) & SHARED))
+        coherence->upgrade(coherence_id, addr & ~(linesz-1));
+      set_flags(hit_way, DIRTY);
+    }
     return;
   }
 
   store ? write_misses++ : read_misses++;
+  if (profile)
+    profile->miss(profile_id, addr, store);
   if (log)
   {
     std::cerr << name << " "
@@ -144,42 +363,104 @@ void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
 
   uint64_t victim = victimize(addr);
 
-  if ((victim & (VALID | DIRTY)) == (VALID | DIRTY))
+  if (victim & VALID)
   {
-    uint64_t dirty_addr = (victim & ~(VALID | DIRTY)) << idx_shift;
-    if (miss_handler)
-      miss_handler->access(dirty_addr, linesz, true);
-    writebacks++;
+    uint64_t victim_addr = (victim & ~(VALID | DIRTY | SHARED)) << idx_shift;
+    if (coherence)
+      coherence->evict(coherence_id, victim_addr);
+    // modified copies above go out with the victim
+    if (inclusive_of && inclusive_of->back_invalidate(victim_addr, linesz))
+      victim |= DIRTY;
+    if (victim & DIRTY)
+    {
+      if (miss_handler)
+        miss_handler->access(victim_addr, linesz, true);
+      writebacks++;
+    }
   }
 
   if (miss_handler)
     miss_handler->access(addr & ~(linesz-1), linesz, false);
 
+  bool shared = coherence && coherence->fill(coherence_id, addr & ~(linesz-1), store);
   if (store)
-    *check_tag(addr) |= DIRTY;
+    set_flags(check_tag(addr), DIRTY);
+  else if (shared)
+    set_flags(check_tag(addr), SHARED);
 }
 
 fa_cache_sim_t::fa_cache_sim_t(size_t ways, size_t linesz, const char* name)
   : cache_sim_t(1, ways, linesz, name)
 {
+  lines.reserve(ways);
 }
 
 uint64_t* fa_cache_sim_t::check_tag(uint64_t addr)
 {
-  auto it = tags.find(addr >> idx_shift);
-  return it == tags.end() ? NULL : &it->second;
+  auto it = index.find(addr >> idx_shift);
+  return it == index.end() ? NULL : &lines[it->second];
 }
 
 uint64_t fa_cache_sim_t::victimize(uint64_t addr)
 {
   uint64_t old_tag = 0;
-  if (tags.size() == ways)
-  {
-    auto it = tags.begin();
-    std::advance(it, lfsr.next() % ways);
-    old_tag = it->second;
-    tags.erase(it);
+  size_t i = lines.size();
+  if (i < ways) {
+    lines.push_back(0);
+  } else {
+    i = lfsr.next() % ways;
+    old_tag = lines[i];
+    index.erase(old_tag & ~(VALID | DIRTY | SHARED));
   }
-  tags[addr >> idx_shift] = (addr >> idx_shift) | VALID;
+  lines[i] = (addr >> idx_shift) | VALID;
+  index[addr >> idx_shift] = i;
   return old_tag;
 }
+
+void fa_cache_sim_t::drop(uint64_t* line)
+{
+  size_t i = line - lines.data();
+  index.erase(*line & ~(VALID | DIRTY | SHARED));
+  if (i != lines.size() - 1) {
+    lines[i] = lines.back();
+    index[lines[i] & ~(VALID | DIRTY | SHARED)] = i;
+  }
+  lines.pop_back();
+}
+
+fa_lru_cache_sim_t::fa_lru_cache_sim_t(size_t ways, size_t linesz, const char* name)
+  : cache_sim_t(1, ways, linesz, name)
+{
+}
+
+uint64_t* fa_lru_cache_sim_t::check_tag(uint64_t addr)
+{
+  auto it = index.find(addr >> idx_shift);
+  return it == index.end() ? NULL : &*it->second;
+}
+
+uint64_t fa_lru_cache_sim_t::victimize(uint64_t addr)
+{
+  uint64_t old_tag = 0;
+  if (lines.size() == ways) {
+    old_tag = lines.back();
+    index.erase(old_tag & ~(VALID | DIRTY | SHARED));
+    lines.pop_back();
+  }
+  lines.push_front((addr >> idx_shift) | VALID);
+  index[addr >> idx_shift] = lines.begin();
+  return old_tag;
+}
+
+void fa_lru_cache_sim_t::touch(uint64_t* line)
+{
+  auto it = index[*line & ~(VALID | DIRTY | SHARED)];
+  lines.splice(lines.begin(), lines, it);
+}
+
+void fa_lru_cache_sim_t::drop(uint64_t* line)
+{
+  auto it = index.find(*line & ~(VALID | DIRTY | SHARED));
+  lines.erase(it->second);
+  index.erase(it);
+}
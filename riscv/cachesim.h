@@ -6,7 +6,9 @@
 #include "memtracer.h"
 #include <cstring>
 #include <string>
-#include <map>
+#include <list>
+#include <unordered_map>
+#include <vector>
 #include <cstdint>
 
 class lfsr_t
@@ -19,10 +21,31 @@ class lfsr_t
   uint32_t reg;
 };
 
+// Chooses the way of a set to replace on a miss.  It is told of each hit,
+// each line filled and each line invalidated, by set and way.
+class repl_policy_t
+{
+ public:
+  virtual ~repl_policy_t() {}
+  virtual repl_policy_t* clone() const = 0;
+  virtual size_t victim(size_t set) = 0;
+  virtual void hit(size_t set, size_t way) = 0;
+  virtual void fill(size_t set, size_t way) = 0;
+  virtual void invalidate(size_t set, size_t way) {}
+
+  // random, lru, plru (tree pseudo-LRU, for a power-of-2 number of ways) or
+  // srrip (2-bit static re-reference interval prediction); NULL for others
+  static repl_policy_t* construct(const std::string& name, size_t sets, size_t ways);
+};
+
+class coherence_t;
+class miss_profile_t;
+
 class cache_sim_t
 {
  public:
-  cache_sim_t(size_t sets, size_t ways, size_t linesz, const char* name);
+  cache_sim_t(size_t sets, size_t ways, size_t linesz, const char* name,
+              const std::string& policy = "random");
   cache_sim_t(const cache_sim_t& rhs);
   virtual ~cache_sim_t();
 
@@ -30,26 +53,69 @@ class cache_sim_t
   void print_stats();
   void set_miss_handler(cache_sim_t* mh) { miss_handler = mh; }
   void set_log(bool _log) { log = _log; }
+  const std::string& get_name() const { return name; }
+  uint64_t get_accesses() const { return read_accesses + write_accesses; }
+  uint64_t get_misses() const { return read_misses + write_misses; }
+  size_t get_linesz() const { return linesz; }
+
+  // Keep this cache coherent with the others of dir, as one of a set of
+  // private caches (see coherence.h).
+  void set_coherence(coherence_t* dir);
+  // Hold every line that the caches of dir hold, replacing a line only
+  // after invalidating it there.
+  void set_inclusive_of(coherence_t* dir) { inclusive_of = dir; }
+  // Drop the line holding addr, writing it back to the miss handler first
+  // if it is dirty and write_back is set.  Returns whether it was dirty.
+  bool invalidate(uint64_t addr, bool write_back);
+  // Make the line holding addr shared, writing it back first if it is
+  // dirty.  Returns whether it was dirty.
+  bool share(uint64_t addr);
+  // Attribute misses to profile as its cache id (see missprof.h).
+  void set_miss_profile(miss_profile_t* profile, unsigned id)
+  {
+    this->profile = profile;
+    profile_id = id;
+  }
 
+  // config is sets:ways:blocksize[:policy]
   static cache_sim_t* construct(const char* config, const char* name);
 
  protected:
   static const uint64_t VALID = 1ULL << 63;
   static const uint64_t DIRTY = 1ULL << 62;
+  static const uint64_t SHARED = 1ULL << 61;  // clean, and maybe in other caches
 
   virtual uint64_t* check_tag(uint64_t addr);
+  // replace a line of addr's set with addr's; returns the old tag, with its
+  // DIRTY and SHARED flags
   virtual uint64_t victimize(uint64_t addr);
+  // the DIRTY and SHARED flags of line, as found by check_tag()
+  virtual uint64_t get_flags(uint64_t* line) { return flags[line - tags]; }
+  virtual void set_flags(uint64_t* line, uint64_t f) { flags[line - tags] = f; }
+  // tell the replacement policy of a hit on line, as found by check_tag()
+  virtual void touch(uint64_t* line);
+  // invalidate line, as found by check_tag()
+  virtual void drop(uint64_t* line);
 
   lfsr_t lfsr;
   cache_sim_t* miss_handler;
+  repl_policy_t* policy;
+  coherence_t* coherence;
+  unsigned coherence_id;
+  coherence_t* inclusive_of;
+  miss_profile_t* profile;
+  unsigned profile_id;
 
   size_t sets;
   size_t ways;
   size_t linesz;
   size_t idx_shift;
 
+  // Each set's tags, with VALID, are kept together without their flags,
+  // so that check_tag() compares a host SIMD register's worth at once.
   uint64_t* tags;
-  
+  uint64_t* flags;
+
   uint64_t read_accesses;
   uint64_t read_misses;
   uint64_t bytes_read;
@@ -61,18 +127,40 @@ class cache_sim_t
   std::string name;
   bool log;
 
-  void init();
+  void init(const std::string& policy);
 };
 
+// Fully-associative caches look their lines up in a hash table rather than
+// searching every way, and keep each line's flags in its tag.  This one replaces a random line.
 class fa_cache_sim_t : public cache_sim_t
 {
  public:
   fa_cache_sim_t(size_t ways, size_t linesz, const char* name);
   uint64_t* check_tag(uint64_t addr);
   uint64_t victimize(uint64_t addr);
+  void touch(uint64_t* line) {}
+  void drop(uint64_t* line);
+  uint64_t get_flags(uint64_t* line) { return *line & (DIRTY | SHARED); }
+  void set_flags(uint64_t* line, uint64_t f) { *line = (*line & ~(DIRTY | SHARED)) | f; }
  private:
-  static bool cmp(uint64_t a, uint64_t b);
-  std::map<uint64_t, uint64_t> tags;
+  std::vector<uint64_t> lines;
+  std::unordered_map<uint64_t, size_t> index;  // line number to its place
+};
+
+// This one replaces the least recently used line, kept last in a list.
+class fa_lru_cache_sim_t : public cache_sim_t
+{
+ public:
+  fa_lru_cache_sim_t(size_t ways, size_t linesz, const char* name);
+  uint64_t* check_tag(uint64_t addr);
+  uint64_t victimize(uint64_t addr);
+  void touch(uint64_t* line);
+  void drop(uint64_t* line);
+  uint64_t get_flags(uint64_t* line) { return *line & (DIRTY | SHARED); }
+  void set_flags(uint64_t* line, uint64_t f) { *line = (*line & ~(DIRTY | SHARED)) | f; }
+ private:
+  std::list<uint64_t> lines;  // most recently used first
+  std::unordered_map<uint64_t, std::list<uint64_t>::iterator> index;
 };
 
 class cache_memtracer_t : public memtracer_t
@@ -94,6 +182,10 @@ class cache_memtracer_t : public memtracer_t
   {
     cache->set_log(log);
   }
+  cache_sim_t* get_cache()
+  {
+    return cache;
+  }
 
  protected:
   cache_sim_t* cache;
@@ -102,7 +194,8 @@ class cache_memtracer_t : public memtracer_t
 class icache_sim_t : public cache_memtracer_t
 {
  public:
-  icache_sim_t(const char* config) : cache_memtracer_t(config, "I$") {}
+  icache_sim_t(const char* config, const char* name = "I$")
+    : cache_memtracer_t(config, name) {}
   bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
   {
     return type == FETCH;
@@ -116,7 +209,8 @@ class icache_sim_t : public cache_memtracer_t
 class dcache_sim_t : public cache_memtracer_t
 {
  public:
-  dcache_sim_t(const char* config) : cache_memtracer_t(config, "D$") {}
+  dcache_sim_t(const char* config, const char* name = "D$")
+    : cache_memtracer_t(config, name) {}
   bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
   {
     return type == LOAD || type == STORE;
@@ -0,0 +1,568 @@
+// See LICENSE for license details.
+
+#include "checkpoint.h"
+#include "sim.h"
+#include "mmu.h"
+#include "trap.h"
+#include "byteorder.h"
+#include "opcodes.h"
+#include <errno.h>
+#include <string.h>
+#include <cinttypes>
+#include <functional>
+#include <stdexcept>
+
+#define CHECKPOINT_MAGIC    0x504b43454b495053ULL  // "SPIKECKP", little-endian
+#define CHECKPOINT_VERSION  2
+
+// marks the end of a memory's pages
+#define CHECKPOINT_END_OF_PAGES  reg_t(-1)
+
+checkpoint_file_t::checkpoint_file_t(const std::string& path, bool saving)
+  : path(path), save(saving)
+{
+  f = fopen(path.c_str(), saving ? "wb" : "rb");
+  if (!f)
+    throw std::runtime_error("couldn't open checkpoint " + path + ": " + strerror(errno));
+}
+
+checkpoint_file_t::~checkpoint_file_t()
+{
+  fclose(f);
+}
+
+void checkpoint_file_t::bytes(void* p, size_t n)
+{
+  if (save ? fwrite(p, 1, n, f) != n : fread(p, 1, n, f) != n)
+    throw std::runtime_error("couldn't " + std::string(save ? "write" : "read") +
+                             " checkpoint " + path);
+}
+
+void checkpoint_file_t::vec(std::vector<bool>& v)
+{
+  std::vector<uint8_t> bytes(v.begin(), v.end());
+  vec(bytes);
+  v.assign(bytes.begin(), bytes.end());
+}
+
+void checkpoint_file_t::str(std::string& s)
+{
+  std::vector<char> chars(s.begin(), s.end());
+  vec(chars);
+  s.assign(chars.begin(), chars.end());
+}
+
+void checkpoint_file_t::expect(uint64_t v, const char* what)
+{
+  uint64_t saved = v;
+  pod(saved);
+  if (saved != v)
+    throw std::runtime_error("checkpoint " + path + " has a different " + what);
+}
+
+// The architectural state of a hart, in file order.  Logging and the
+// registers written by the last step are not saved.
+static void checkpoint_state(checkpoint_file_t& f, state_t& s)
+{
+  f.pod(s.pc);
+  f.pod(s.XPR);
+  f.pod(s.FPR);
+  f.pod(s.prv);
+  f.pod(s.v);
+  f.pod(s.misa);
+  f.pod(s.mstatus);
+  f.pod(s.mepc);
+  f.pod(s.mtval);
+  f.pod(s.mscratch);
+  f.pod(s.mtvec);
+  f.pod(s.mcause);
+  f.pod(s.mcycle);
+  f.pod(s.minstret);
+  f.pod(s.mie);
+  f.pod(s.mip);
+  f.pod(s.medeleg);
+  f.pod(s.mideleg);
+  f.pod(s.mcounteren);
+  f.pod(s.scounteren);
+  f.pod(s.sepc);
+  f.pod(s.stval);
+  f.pod(s.sscratch);
+  f.pod(s.stvec);
+  f.pod(s.satp);
+  f.pod(s.scause);
+  f.pod(s.mtval2);
+  f.pod(s.mtinst);
+  f.pod(s.hstatus);
+  f.pod(s.hideleg);
+  f.pod(s.hedeleg);
+  f.pod(s.hcounteren);
+  f.pod(s.htval);
+  f.pod(s.htinst);
+  f.pod(s.hgatp);
+  f.pod(s.vsstatus);
+  f.pod(s.vstvec);
+  f.pod(s.vsscratch);
+  f.pod(s.vsepc);
+  f.pod(s.vscause);
+  f.pod(s.vstval);
+  f.pod(s.vsatp);
+  f.pod(s.dpc);
+  f.pod(s.dscratch0);
+  f.pod(s.dscratch1);
+  f.pod(s.dcsr);
+  f.pod(s.tselect);
+  f.pod(s.mcontrol);
+  f.pod(s.tdata2);
+  f.pod(s.debug_mode);
+  f.pod(s.pmpcfg);
+  f.pod(s.pmpaddr);
+  f.pod(s.fflags);
+  f.pod(s.frm);
+  f.pod(s.serialized);
+  f.pod(s.single_step);
+}
+
+static bool page_is_zero(const char* page)
+{
+  const uint64_t* p = (const uint64_t*)page;
+  for (size_t i = 0; i < PGSIZE / sizeof(uint64_t); i++)
+    if (p[i])
+      return false;
+  return true;
+}
+
+// Only nonzero pages are saved.  When restoring, pages missing from the
+// file are cleared, but only if they are not already zero, so that memory
+// the program never touched is left unallocated on the host.
+static void checkpoint_mem(checkpoint_file_t& f, char* mem, size_t size)
+{
+  reg_t npages = size / PGSIZE;
+
+  if (f.saving()) {
+    for (reg_t i = 0; i < npages; i++) {
+      if (!page_is_zero(mem + i * PGSIZE)) {
+        f.pod(i);
+        f.bytes(mem + i * PGSIZE, PGSIZE);
+      }
+    }
+    reg_t end = CHECKPOINT_END_OF_PAGES;
+    f.pod(end);
+    return;
+  }
+
+  reg_t next;
+  f.pod(next);
+  for (reg_t i = 0; i < npages; i++) {
+    char* page = mem + i * PGSIZE;
+    if (i == next) {
+      f.bytes(page, PGSIZE);
+      f.pod(next);
+    } else if (!page_is_zero(page)) {
+      memset(page, 0, PGSIZE);
+    }
+  }
+  if (next != CHECKPOINT_END_OF_PAGES)
+    throw std::runtime_error("checkpoint has a page outside memory");
+}
+
+// An incremental checkpoint saves the pages in dirty that lie in this
+// memory, zero or not, and restores just those.
+static void checkpoint_mem_pages(checkpoint_file_t& f, char* mem, reg_t base,
+                                 size_t size, const std::vector<reg_t>& dirty)
+{
+  reg_t npages = size / PGSIZE;
+
+  if (f.saving()) {
+    for (reg_t addr : dirty) {
+      if (addr >= base && addr - base < size) {
+        reg_t i = (addr - base) / PGSIZE;
+        f.pod(i);
+        f.bytes(mem + i * PGSIZE, PGSIZE);
+      }
+    }
+    reg_t end = CHECKPOINT_END_OF_PAGES;
+    f.pod(end);
+    return;
+  }
+
+  reg_t i;
+  for (f.pod(i); i != CHECKPOINT_END_OF_PAGES; f.pod(i)) {
+    if (i >= npages)
+      throw std::runtime_error("checkpoint has a page outside memory");
+    f.bytes(mem + i * PGSIZE, PGSIZE);
+  }
+}
+
+// A parent is named relative to the directory of the checkpoint naming it.
+static std::string dir_name(const std::string& path)
+{
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+static std::string base_name(const std::string& path)
+{
+  return path.substr(dir_name(path).size());
+}
+
+void sim_t::checkpoint_header(checkpoint_file_t& f, std::string& parent)
+{
+  f.expect(CHECKPOINT_MAGIC, "format");
+  f.expect(CHECKPOINT_VERSION, "format version");
+  f.expect(procs.size(), "number of harts");
+  f.expect(procs[0]->VU.vlenb, "vector length");
+  f.expect(mems.size(), "number of memories");
+  f.str(parent);
+}
+
+void sim_t::checkpoint(checkpoint_file_t& f, std::string& parent,
+                       const std::vector<reg_t>& dirty)
+{
+  checkpoint_header(f, parent);
+
+  for (processor_t* p : procs) {
+    sim_snapshot_t::hart_t h;
+    save_hart(p, h);
+    checkpoint_state(f, h.state);
+    f.pod(h.vector);
+    f.vec(h.vregs);
+    if (!f.saving()) {
+      // not saved: an SC may fail spuriously after a restore
+      h.load_reservation = reg_t(-1);
+      restore_hart(p, h);
+    }
+  }
+
+  clint_t::snapshot_t clint_state = clint->save();
+  f.pod(clint_state.mtime);
+  f.vec(clint_state.mtimecmp);
+#ifdef ZJV_DEVICE_EXTENSTION
+  plic_t::snapshot_t plic_state = plic->save();
+  f.vec(plic_state.priority);
+  f.vec(plic_state.ie);
+  f.vec(plic_state.ip);
+  f.vec(plic_state.threshold);
+  f.vec(plic_state.claimed);
+  f.vec(plic_state.level);
+  uart_t::snapshot_t uart_state = uart->save();
+  f.pod(uart_state);
+#endif
+  debug_module.checkpoint(f);
+  f.pod(current_step);
+  f.pod(current_proc);
+
+  for (auto& m : mems) {
+    f.expect(m.first, "memory base");
+    f.expect(m.second->size(), "memory size");
+    if (parent.empty())
+      checkpoint_mem(f, m.second->contents(), m.second->size());
+    else
+      checkpoint_mem_pages(f, m.second->contents(), m.first, m.second->size(), dirty);
+  }
+
+  if (f.saving())
+    return;
+
+  clint->restore(clint_state);
+#ifdef ZJV_DEVICE_EXTENSTION
+  plic->restore(plic_state);
+  uart->restore(uart_state);
+#endif
+
+  // the snapshots describe a past that never happened now
+  snapshots.clear();
+  if (snapshot_tracer)
+    snapshot_tracer->set_snapshot(NULL);
+  debug_mmu->flush_tlb();
+  if (decode_cache)
+    decode_cache->flush();
+}
+
+void sim_t::save_checkpoint(const std::string& path)
+{
+  checkpoint_file_t f(path, true);
+  std::string parent;
+  checkpoint(f, parent, std::vector<reg_t>());
+  start_checkpoint_dirty_log(path);
+}
+
+void sim_t::save_incremental_checkpoint(const std::string& path)
+{
+  if (checkpoint_parent.empty())
+    throw std::runtime_error("no checkpoint saved for " + path + " to follow");
+  if (dir_name(path) != dir_name(checkpoint_parent))
+    throw std::runtime_error("checkpoint " + path + " isn't next to its parent " +
+                             checkpoint_parent);
+
+  checkpoint_file_t f(path, true);
+  std::string parent = base_name(checkpoint_parent);
+  checkpoint(f, parent, checkpoint_dirty_log->take(SIZE_MAX));
+  start_checkpoint_dirty_log(path);
+}
+
+void sim_t::restore_checkpoint(const std::string& path)
+{
+  // Restore each checkpoint of the chain that ends at path in turn, from
+  // the full one, which is last to be found.
+  std::vector<std::string> chain(1, path);
+  for (;;) {
+    checkpoint_file_t f(chain.back(), false);
+    std::string parent;
+    checkpoint_header(f, parent);
+    if (parent.empty())
+      break;
+    chain.push_back(dir_name(chain.back()) + parent);
+  }
+
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    checkpoint_file_t f(*it, false);
+    std::string parent;
+    checkpoint(f, parent, std::vector<reg_t>());
+  }
+
+  // what was saved before no longer describes the past
+  checkpoint_parent.clear();
+}
+
+// Log the pages stored to from now on, for an incremental checkpoint to
+// follow the one just saved at path.
+void sim_t::start_checkpoint_dirty_log(const std::string& path)
+{
+  if (!checkpoint_dirty_log) {
+    checkpoint_dirty_log.reset(new dirty_log_t);
+    for (processor_t* p : procs)
+      p->get_mmu()->register_memtracer(checkpoint_dirty_log.get());
+  }
+  checkpoint_dirty_log->clear();
+  checkpoint_parent = path;
+
+  // refill the TLBs, so that they trace stores to pages not yet logged
+  for (processor_t* p : procs)
+    p->get_mmu()->flush_tlb();
+}
+
+// Boot images.  The restore ROM's code is the same for every hart: it
+// points t0 at the hart's own table of values, indexed by mhartid, and
+// loads each register from a slot in it.  Tables are this many bytes apart,
+// so every slot is within a ld's reach of t0.
+#define BOOT_IMAGE_TABLE_SHIFT 10
+
+namespace {
+
+class restore_rom_t
+{
+ public:
+  typedef std::function<reg_t(processor_t*)> value_t;
+
+  // index of the addi that adds the table offset to t0
+  static const size_t TABLE_ADDI = 4;
+
+  size_t size() const { return code.size(); }
+  void emit(uint32_t insn) { code.push_back(insn); }
+
+  // load the hart's value into integer register rd
+  void load(unsigned rd, value_t value)
+  {
+    emit(ld(rd, T0, slots.size() * sizeof(reg_t)));
+    slots.push_back(value);
+  }
+
+  // load the low 64 bits of the value into FPR rd, or the low 32 with flw
+  // if the hart has F but not D
+  void load_fp(unsigned rd, value_t value, bool d)
+  {
+    reg_t offset = slots.size() * sizeof(reg_t);
+    emit(d ? fld(rd, T0, offset) : flw(rd, T0, offset));
+    slots.push_back(value);
+  }
+
+  void write_csr(int csr, value_t value)
+  {
+    load(T1, value);
+    emit(csrw(T1, csr));
+  }
+
+  std::vector<char> build(const std::vector<processor_t*>& procs)
+  {
+    size_t table = (code.size() * sizeof(uint32_t) + sizeof(reg_t) - 1) & -sizeof(reg_t);
+    if (table >= 2048 || slots.size() * sizeof(reg_t) > (1 << BOOT_IMAGE_TABLE_SHIFT))
+      throw std::runtime_error("restore ROM is too big");
+    code[TABLE_ADDI] = addi(T0, T0, table);
+
+    std::vector<char> rom(table + (procs.size() << BOOT_IMAGE_TABLE_SHIFT));
+    for (size_t i = 0; i < code.size(); i++) {
+      uint32_t insn = to_le(code[i]);
+      memcpy(&rom[i * sizeof insn], &insn, sizeof insn);
+    }
+    for (size_t i = 0; i < procs.size(); i++) {
+      for (size_t j = 0; j < slots.size(); j++) {
+        reg_t v = to_le(slots[j](procs[i]));
+        memcpy(&rom[table + (i << BOOT_IMAGE_TABLE_SHIFT) + j * sizeof v], &v, sizeof v);
+      }
+    }
+    return rom;
+  }
+
+ private:
+  std::vector<uint32_t> code;
+  std::vector<value_t> slots;
+};
+
+}
+
+// Read a CSR as the restore ROM, in M-mode, would; false if the hart has
+// no such CSR.
+static bool read_csr_in_m(processor_t* p, int which, reg_t* val)
+{
+  state_t* s = p->get_state();
+  reg_t prv = s->prv;
+  bool ok = true;
+  s->prv = PRV_M;
+  try {
+    *val = p->get_csr(which);
+  } catch (trap_t&) {
+    ok = false;
+  }
+  s->prv = prv;
+  return ok;
+}
+
+static reg_t csr_value(processor_t* p, int which)
+{
+  reg_t val = 0;
+  read_csr_in_m(p, which, &val);
+  return val;
+}
+
+static void write_file(const std::string& path, const char* data, size_t len)
+{
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f)
+    throw std::runtime_error("couldn't open " + path + ": " + strerror(errno));
+  bool ok = fwrite(data, 1, len, f) == len;
+  ok = fclose(f) == 0 && ok;
+  if (!ok)
+    throw std::runtime_error("couldn't write " + path);
+}
+
+void sim_t::export_boot_image(const std::string& prefix)
+{
+  processor_t* p0 = procs[0];
+  if (p0->get_xlen() != 64)
+    throw std::runtime_error("boot images need RV64 harts");
+  for (size_t i = 0; i < procs.size(); i++) {
+    state_t* s = procs[i]->get_state();
+    if (csr_value(procs[i], CSR_MHARTID) != i)
+      throw std::runtime_error("boot images need hart IDs 0 to n-1");
+    if (s->v || s->debug_mode)
+      throw std::runtime_error("boot images can't restore virtualization or debug mode");
+  }
+
+  restore_rom_t rom;
+  rom.emit(auipc(T0, 0));
+  rom.emit(csrr(T1, CSR_MHARTID));
+  rom.emit(slli(T1, T1, BOOT_IMAGE_TABLE_SHIFT));
+  rom.emit(add(T0, T0, T1));
+  rom.emit(0);  // restore_rom_t::TABLE_ADDI
+
+  // While the ROM runs, interrupts are off, loads are not translated, and
+  // the FPU is on so that the FPRs can be loaded.
+  bool fp = p0->supports_extension('F');
+  bool fp_d = p0->supports_extension('D');
+  rom.write_csr(CSR_MSTATUS, [fp](processor_t* p) {
+    reg_t mstatus = p->get_state()->mstatus & ~(MSTATUS_MIE | MSTATUS_MPRV);
+    return fp ? mstatus | MSTATUS_FS : mstatus;
+  });
+
+  // PMP addresses before their configurations, which may lock them
+  std::vector<int> csrs = {
+    CSR_MEDELEG, CSR_MIDELEG, CSR_MIE, CSR_MIP, CSR_MTVEC, CSR_MSCRATCH,
+    CSR_MCAUSE, CSR_MTVAL, CSR_MCOUNTEREN, CSR_SCOUNTEREN, CSR_STVEC,
+    CSR_SSCRATCH, CSR_SEPC, CSR_SCAUSE, CSR_STVAL, CSR_SATP,
+  };
+  for (int i = 0; i < state_t::max_pmp; i++)
+    csrs.push_back(CSR_PMPADDR0 + i);
+  for (int i = 0; i < state_t::max_pmp / 4; i++)
+    csrs.push_back(CSR_PMPCFG0 + i);
+  for (int csr : csrs) {
+    reg_t val;
+    if (!read_csr_in_m(p0, csr, &val))
+      continue;
+    rom.write_csr(csr, [csr](processor_t* p) { return csr_value(p, csr); });
+    if (csr == CSR_SATP)
+      rom.emit(sfence_vma());
+  }
+
+  if (fp) {
+    rom.write_csr(CSR_FCSR, [](processor_t* p) {
+      return reg_t(p->get_state()->fflags | (p->get_state()->frm << FSR_RD_SHIFT));
+    });
+    for (unsigned i = 0; i < NFPR; i++)
+      rom.load_fp(i, [i](processor_t* p) { return reg_t(p->get_state()->FPR[i].v[0]); }, fp_d);
+  }
+
+  // Each hart sets its mtimecmp.  Hart 0 then sets mtime, and the others
+  // store their mtimecmp again instead.
+  clint_t::snapshot_t clint_state = clint->save();
+  auto mtimecmp_addr = [](processor_t* p) {
+    return CLINT_BASE + MTIMECMP_BASE + csr_value(p, CSR_MHARTID) * sizeof(uint64_t);
+  };
+  auto mtimecmp = [clint_state](processor_t* p) {
+    return reg_t(clint_state.mtimecmp[csr_value(p, CSR_MHARTID)]);
+  };
+  rom.load(T2, mtimecmp_addr);
+  rom.load(T1, mtimecmp);
+  rom.emit(sd(T1, T2, 0));
+  rom.load(T2, [mtimecmp_addr](processor_t* p) {
+    return csr_value(p, CSR_MHARTID) == 0 ? CLINT_BASE + MTIME_BASE : mtimecmp_addr(p);
+  });
+  rom.load(T1, [clint_state, mtimecmp](processor_t* p) {
+    return csr_value(p, CSR_MHARTID) == 0 ? reg_t(clint_state.mtime) : mtimecmp(p);
+  });
+  rom.emit(sd(T1, T2, 0));
+
+  // mret enters the saved privilege mode at the saved pc, and sets MIE from
+  // MPIE.  So mepc, MPIE and MPP end up holding what mret leaves in them,
+  // rather than their saved values, and MPRV ends up clear.
+  rom.write_csr(CSR_MSTATUS, [](processor_t* p) {
+    state_t* s = p->get_state();
+    reg_t mstatus = s->mstatus & ~(MSTATUS_MIE | MSTATUS_MPRV);
+    mstatus = set_field(mstatus, MSTATUS_MPIE, get_field(s->mstatus, MSTATUS_MIE));
+    return set_field(mstatus, MSTATUS_MPP, s->prv);
+  });
+  rom.write_csr(CSR_MEPC, [](processor_t* p) { return p->get_state()->pc; });
+
+  // The counters are set to their saved values less the instructions still
+  // to retire, so that they match once the ROM has jumped.
+  reg_t val;
+  for (int csr : {CSR_MCYCLE, CSR_MINSTRET}) {
+    if (!read_csr_in_m(p0, csr, &val))
+      continue;
+    size_t written = rom.size() + 2;
+    rom.write_csr(csr, [csr, written, &rom](processor_t* p) {
+      return csr_value(p, csr) - (rom.size() - written);
+    });
+  }
+
+  // t0 last, as it points at the table
+  for (unsigned i = 1; i < NXPR; i++) {
+    if (i != T0)
+      rom.load(i, [i](processor_t* p) { return p->get_state()->XPR[i]; });
+  }
+  rom.load(T0, [](processor_t* p) { return p->get_state()->XPR[T0]; });
+  rom.emit(mret());
+
+  std::vector<char> image = rom.build(procs);
+  write_file(prefix + "-rom.bin", image.data(), image.size());
+
+  // Each memory is written up to its last nonzero page.
+  for (auto& m : mems) {
+    char* contents = m.second->contents();
+    size_t len = m.second->size() / PGSIZE * PGSIZE;
+    while (len && page_is_zero(contents + len - PGSIZE))
+      len -= PGSIZE;
+    char base[32];
+    snprintf(base, sizeof base, "-%" PRIx64 ".bin", m.first);
+    write_file(prefix + base, contents, len);
+  }
+}
@@ -0,0 +1,69 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_CHECKPOINT_H
+#define _RISCV_CHECKPOINT_H
+
+// Checkpoint files hold the whole state of a sim_t: the harts, the devices
+// and every nonzero page of memory.  They are read back by the same build
+// of spike, started with the same configuration and program, so the
+// format is simply each field's bytes in a fixed order.  Each object
+// describes its state once, in a checkpoint() method that both saves and
+// restores it through a checkpoint_file_t.
+//
+// An incremental checkpoint holds only the pages stored to since the
+// checkpoint it follows, its parent, which it names.  Restoring it restores
+// the parent first, so a run saved every few billion instructions is a full
+// checkpoint followed by a chain of small ones.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class checkpoint_file_t
+{
+ public:
+  // Opens path to save to, or to restore from; throws std::runtime_error
+  // on failure, as do the methods below.
+  checkpoint_file_t(const std::string& path, bool saving);
+  ~checkpoint_file_t();
+
+  bool saving() const { return save; }
+  const std::string& get_path() const { return path; }
+
+  // write the n bytes at p, or read them into p
+  void bytes(void* p, size_t n);
+
+  template<class T> void pod(T& v) { bytes(&v, sizeof v); }
+
+  template<class T> void vec(std::vector<T>& v)
+  {
+    uint64_t n = v.size();
+    pod(n);
+    v.resize(n);
+    bytes(v.data(), n * sizeof(T));
+  }
+
+  template<class T> void vec(std::vector<std::vector<T>>& v)
+  {
+    uint64_t n = v.size();
+    pod(n);
+    v.resize(n);
+    for (auto& x : v)
+      vec(x);
+  }
+
+  void vec(std::vector<bool>& v);
+  void str(std::string& s);
+
+  // Check, when restoring, that v matches the saved value; what is saved
+  // is the current one.
+  void expect(uint64_t v, const char* what);
+
+ private:
+  std::string path;
+  FILE* f;
+  bool save;
+};
+
+#endif
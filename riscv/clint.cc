@@ -23,10 +23,6 @@ clint_t::clint_t(std::vector<processor_t*>& procs, uint64_t freq_hz, bool real_t
  * bffc mtime hi
  */
 
-#define MSIP_BASE	0x0
-#define MTIMECMP_BASE	0x4000
-#define MTIME_BASE	0xbff8
-
 bool clint_t::load(reg_t addr, size_t len, uint8_t* bytes)
 {
   increment(0);
@@ -54,9 +50,7 @@ bool clint_t::store(reg_t addr, size_t len, const uint8_t* bytes)
     memset((uint8_t*)&mask[0] + addr - MSIP_BASE, 0xff, len);
     for (size_t i = 0; i < procs.size(); ++i) {
       if (!(mask[i] & 0xFF)) continue;
-      procs[i]->state.mip &= ~MIP_MSIP;
-      if (!!(msip[i] & 1))
-        procs[i]->state.mip |= MIP_MSIP;
+      procs[i]->state.set_mip(MIP_MSIP, msip[i] & 1);
     }
   } else if (addr >= MTIMECMP_BASE && addr + len <= MTIMECMP_BASE + procs.size()*sizeof(mtimecmp_t)) {
     memcpy((uint8_t*)&mtimecmp[0] + addr - MTIMECMP_BASE, bytes, len);
@@ -81,10 +75,6 @@ void clint_t::increment(reg_t inc)
   } else {
     mtime += inc;
   }
-  for (size_t i = 0; i < procs.size(); i++) {
-    procs[i]->state.mip &= ~MIP_MTIP;
-    /* Following will remove in next version */
-    if (mtime >= mtimecmp[i])
-      procs[i]->state.mip |= MIP_MTIP;
-  }
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->state.set_mip(MIP_MTIP, mtime >= mtimecmp[i]);
 }
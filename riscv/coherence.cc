@@ -0,0 +1,100 @@
+// See LICENSE for license details.
+
+#include "coherence.h"
+#include "cachesim.h"
+#include <iostream>
+#include <stdexcept>
+
+coherence_t::~coherence_t()
+{
+  print_stats();
+}
+
+unsigned coherence_t::add_cache(cache_sim_t* cache)
+{
+  if (caches.size() == 64)
+    throw std::invalid_argument("a coherence directory holds up to 64 caches");
+  if (linesz && cache->get_linesz() != linesz)
+    throw std::invalid_argument("coherent caches must have the same block size");
+  linesz = cache->get_linesz();
+  caches.push_back(cache);
+  return caches.size() - 1;
+}
+
+void coherence_t::invalidate(uint64_t line, uint64_t mask)
+{
+  for (size_t i = 0; mask; i++, mask >>= 1) {
+    if (mask & 1) {
+      invalidations++;
+      if (caches[i]->invalidate(line, true))
+        coherence_writebacks++;
+    }
+  }
+}
+
+bool coherence_t::fill(unsigned id, uint64_t line, bool store)
+{
+  uint64_t others = holders[line] & ~(1ULL << id);
+
+  if (store) {
+    invalidate(line, others);
+    holders[line] = 1ULL << id;
+    return false;
+  }
+
+  for (size_t i = 0, m = others; m; i++, m >>= 1)
+    if ((m & 1) && caches[i]->share(line))
+      coherence_writebacks++;
+  holders[line] |= 1ULL << id;
+  return others != 0;
+}
+
+void coherence_t::upgrade(unsigned id, uint64_t line)
+{
+  upgrades++;
+  invalidate(line, holders[line] & ~(1ULL << id));
+  holders[line] = 1ULL << id;
+}
+
+void coherence_t::evict(unsigned id, uint64_t line)
+{
+  auto it = holders.find(line);
+  if (it != holders.end() && !(it->second &= ~(1ULL << id)))
+    holders.erase(it);
+}
+
+bool coherence_t::back_invalidate(uint64_t addr, size_t len)
+{
+  if (!linesz)
+    return false;
+
+  bool dirty = false;
+  for (uint64_t line = addr & ~(linesz - 1); line < addr + len; line += linesz) {
+    auto it = holders.find(line);
+    if (it == holders.end())
+      continue;
+    for (size_t i = 0, m = it->second; m; i++, m >>= 1) {
+      if (m & 1) {
+        back_invalidations++;
+        dirty |= caches[i]->invalidate(line, false);
+      }
+    }
+    holders.erase(it);
+  }
+  return dirty;
+}
+
+void coherence_t::print_stats()
+{
+  if ((caches.size() < 2 || holders.empty()) && back_invalidations == 0)
+    return;
+
+  std::cout << "Coherence ";
+  std::cout << "Upgrades:              " << upgrades << std::endl;
+  std::cout << "Coherence ";
+  std::cout << "Invalidations:         " << invalidations << std::endl;
+  std::cout << "Coherence ";
+  std::cout << "Writebacks:            " << coherence_writebacks << std::endl;
+  std::cout << "Coherence ";
+  std::cout << "Back-Invalidations:    " << back_invalidations << std::endl;
+}
@@ -0,0 +1,57 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_COHERENCE_H
+#define _RISCV_COHERENCE_H
+
+#include <cstdint>
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+
+class cache_sim_t;
+
+// A MESI directory for a set of private caches, e.g. each hart's L1 I$ and
+// D$, which share a line size.  It records which of them hold each line.
+// A store invalidates the line in the others, writing back a modified copy
+// first; a load makes their copies shared, writing back a modified one.  A
+// line a cache holds alone is exclusive, and becomes modified on a store
+// without a word to the directory.  The caches tell it of every fill,
+// every store to a shared line (an upgrade) and every line they replace.
+class coherence_t
+{
+ public:
+  coherence_t() : linesz(0), upgrades(0), invalidations(0),
+                  coherence_writebacks(0), back_invalidations(0) {}
+  // prints the statistics
+  ~coherence_t();
+
+  // Returns the cache's id.  Throws std::invalid_argument if its line
+  // size differs from the others', or if there are more than 64 caches.
+  unsigned add_cache(cache_sim_t* cache);
+
+  // Cache id filled line, to load from it or store to it.  Returns whether
+  // another cache still holds the line.
+  bool fill(unsigned id, uint64_t line, bool store);
+  void upgrade(unsigned id, uint64_t line);
+  void evict(unsigned id, uint64_t line);
+  // A cache that includes these ones replaced the len bytes at addr:
+  // invalidate them here too.  Returns whether any copy was modified.
+  bool back_invalidate(uint64_t addr, size_t len);
+
+  void print_stats();
+
+ private:
+  // invalidate line in the caches in mask, writing back modified copies
+  void invalidate(uint64_t line, uint64_t mask);
+
+  size_t linesz;
+  std::vector<cache_sim_t*> caches;
+  std::unordered_map<uint64_t, uint64_t> holders;  // line to caches, a bit each
+
+  uint64_t upgrades;
+  uint64_t invalidations;
+  uint64_t coherence_writebacks;
+  uint64_t back_invalidations;
+};
+
+#endif
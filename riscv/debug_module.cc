@@ -1,6 +1,7 @@
 #include <cassert>
 
 #include "debug_module.h"
+#include "checkpoint.h"
 #include "debug_defines.h"
 #include "opcodes.h"
 #include "mmu.h"
@@ -925,3 +926,26 @@ void debug_module_t::proc_reset(unsigned id)
   hart_state[id].halted = false;
   hart_state[id].haltgroup = 0;
 }
+
+void debug_module_t::checkpoint(checkpoint_file_t& f)
+{
+  f.pod(debug_rom_whereto);
+  f.pod(debug_abstract);
+  f.bytes(program_buffer, program_buffer_bytes);
+  f.pod(dmdata);
+  f.vec(hart_state);
+  f.pod(debug_rom_flags);
+  f.pod(dmcontrol);
+  f.pod(dmstatus);
+  f.pod(abstractcs);
+  f.pod(abstractauto);
+  f.pod(command);
+  f.pod(hawindowsel);
+  f.vec(hart_array_mask);
+  f.pod(sbcs);
+  f.pod(sbaddress);
+  f.pod(sbdata);
+  f.pod(challenge);
+  f.pod(abstract_command_completed);
+  f.pod(rti_remaining);
+}
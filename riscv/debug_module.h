@@ -7,6 +7,7 @@
 #include "devices.h"
 
 class sim_t;
+class checkpoint_file_t;
 
 typedef struct {
     // Size of program_buffer in 32-bit words, as exposed to the rest of the
@@ -126,6 +127,9 @@ class debug_module_t : public abstract_device_t
     // Called when one of the attached harts was reset.
     void proc_reset(unsigned id);
 
+    // save or restore the debugger-visible state (see checkpoint.h)
+    void checkpoint(checkpoint_file_t& f);
+
   private:
     static const unsigned datasize = 2;
     unsigned nprocs;
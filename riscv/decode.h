@@ -141,8 +141,10 @@ class regfile_t
 public:
   void write(size_t i, T value)
   {
-    if (!zero_reg || i != 0)
+    if (!zero_reg || i != 0) {
       data[i] = value;
+      dirty |= (uint64_t)1 << i;
+    }
   }
   const T& operator [] (size_t i) const
   {
@@ -155,9 +157,14 @@ public:
   void reset()
   {
     memset(data, 0, sizeof(data));
+    dirty = 0;
   }
+  // one bit per register written since the last clear_dirty()
+  uint64_t get_dirty() const { return dirty; }
+  void clear_dirty() { dirty = 0; }
 private:
   T data[N];
+  uint64_t dirty;
 };
 
 // helpful macros, etc
@@ -213,9 +220,9 @@ private:
 #define FRS1 READ_FREG(insn.rs1())
 #define FRS2 READ_FREG(insn.rs2())
 #define FRS3 READ_FREG(insn.rs3())
-#define dirty_fp_state (STATE.mstatus |= MSTATUS_FS | (xlen == 64 ? MSTATUS64_SD : MSTATUS32_SD))
-#define dirty_ext_state (STATE.mstatus |= MSTATUS_XS | (xlen == 64 ? MSTATUS64_SD : MSTATUS32_SD))
-#define dirty_vs_state (STATE.mstatus |= MSTATUS_VS | (xlen == 64 ? MSTATUS64_SD : MSTATUS32_SD))
+#define dirty_fp_state (STATE.mark_csr_dirty(CSR_MSTATUS), STATE.mstatus |= MSTATUS_FS | (xlen == 64 ? MSTATUS64_SD : MSTATUS32_SD))
+#define dirty_ext_state (STATE.mark_csr_dirty(CSR_MSTATUS), STATE.mstatus |= MSTATUS_XS | (xlen == 64 ? MSTATUS64_SD : MSTATUS32_SD))
+#define dirty_vs_state (STATE.mark_csr_dirty(CSR_MSTATUS), STATE.mstatus |= MSTATUS_VS | (xlen == 64 ? MSTATUS64_SD : MSTATUS32_SD))
 #define DO_WRITE_FREG(reg, value) (STATE.FPR.write(reg, value), dirty_fp_state)
 #define WRITE_FRD(value) WRITE_FREG(insn.rd(), value)
  
@@ -269,10 +276,18 @@ private:
 
 #define set_fp_exceptions ({ if (softfloat_exceptionFlags) { \
                                dirty_fp_state; \
+                               STATE.mark_csr_dirty(CSR_FFLAGS); \
                                STATE.fflags |= softfloat_exceptionFlags; \
                              } \
                              softfloat_exceptionFlags = 0; })
 
+// vxsat is sticky: saturating instructions only ever set it
+#define set_vxsat(sat) ({ if ((sat) && !P.VU.vxsat) { \
+                            STATE.mark_csr_dirty(CSR_VXSAT); \
+                            STATE.mark_csr_dirty(CSR_VCSR); \
+                            P.VU.vxsat = 1; \
+                          } })
+
 #define sext32(x) ((sreg_t)(int32_t)(x))
 #define zext32(x) ((reg_t)(uint32_t)(x))
 #define sext_xlen(x) (((sreg_t)(x) << (64-xlen)) >> (64-xlen))
@@ -651,37 +666,19 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   } \
   P.VU.vstart = 0; 
 
-#define VI_LOOP_CMP_BASE \
-  require(P.VU.vsew >= e8 && P.VU.vsew <= e64); \
-  require_vector(true);\
-  reg_t vl = P.VU.vl; \
-  reg_t sew = P.VU.vsew; \
-  reg_t rd_num = insn.rd(); \
-  reg_t rs1_num = insn.rs1(); \
-  reg_t rs2_num = insn.rs2(); \
-  for (reg_t i=P.VU.vstart; i<vl; ++i){ \
-    VI_LOOP_ELEMENT_SKIP(); \
-    uint64_t mmask = UINT64_C(1) << mpos; \
-    uint64_t &vdi = P.VU.elt<uint64_t>(insn.rd(), midx, true); \
-    uint64_t res = 0;
-
-#define VI_LOOP_CMP_END \
-    vdi = (vdi & ~mmask) | (((res) << mpos) & mmask); \
-  } \
-  P.VU.vstart = 0;
-
+// mask-register logical ops work on a whole 64-bit mask word at a time
 #define VI_LOOP_MASK(op) \
   require(P.VU.vsew <= e64); \
   require_vector(true);\
   reg_t vl = P.VU.vl; \
-  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
+  for (reg_t i = P.VU.vstart; i < vl; i = (i | 63) + 1) { \
     int midx = i / 64; \
-    int mpos = i % 64; \
-    uint64_t mmask = UINT64_C(1) << mpos; \
+    uint64_t mmask = (UINT64_MAX << (i % 64)) & \
+      (vl - midx * 64 >= 64 ? UINT64_MAX : (UINT64_C(1) << (vl % 64)) - 1); \
     uint64_t vs2 = P.VU.elt<uint64_t>(insn.rs2(), midx); \
     uint64_t vs1 = P.VU.elt<uint64_t>(insn.rs1(), midx); \
     uint64_t &res = P.VU.elt<uint64_t>(insn.rd(), midx, true); \
-    res = (res & ~mmask) | ((op) & (1ULL << mpos)); \
+    res = (res & ~mmask) | ((op) & mmask); \
   } \
   P.VU.vstart = 0;
 
@@ -831,135 +828,248 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   auto &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true);
 
 //
-// vector: integer and masking operation loop
+// vector: hoisted operand access
+//
+// On little-endian hosts the integer loops below look up each operand's
+// register group once per instruction with elt_group() and then index it
+// directly, rather than calling elt() for every operand of every element.
+// BODY sees the same operand names either way.
 //
+#define VI_GROUP(type, reg, is_write) \
+  P.VU.elt_group<type>(reg, P.VU.vstart, vl, is_write)
+
+#define VV_PARAMS_BASE(x) \
+  type_sew_t<x>::type *vd_base = VI_GROUP(type_sew_t<x>::type, rd_num, true); \
+  type_sew_t<x>::type *vs1_base = VI_GROUP(type_sew_t<x>::type, rs1_num, false); \
+  type_sew_t<x>::type *vs2_base = VI_GROUP(type_sew_t<x>::type, rs2_num, false);
+
+#define VV_PARAMS_ELT(x) \
+  type_sew_t<x>::type &vd = vd_base[i]; \
+  type_sew_t<x>::type vs1 = vs1_base[i]; \
+  type_sew_t<x>::type vs2 = vs2_base[i];
 
-// comparision result to masking register
-#define VI_VV_LOOP_CMP(BODY) \
-  VI_CHECK_MSS(true); \
-  VI_LOOP_CMP_BASE \
-  if (sew == e8){ \
-    VV_CMP_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VV_CMP_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VV_CMP_PARAMS(e32); \
+#define VV_U_PARAMS_BASE(x) \
+  type_usew_t<x>::type *vd_base = VI_GROUP(type_usew_t<x>::type, rd_num, true); \
+  type_usew_t<x>::type *vs1_base = VI_GROUP(type_usew_t<x>::type, rs1_num, false); \
+  type_usew_t<x>::type *vs2_base = VI_GROUP(type_usew_t<x>::type, rs2_num, false);
+
+#define VV_U_PARAMS_ELT(x) \
+  type_usew_t<x>::type &vd = vd_base[i]; \
+  type_usew_t<x>::type vs1 = vs1_base[i]; \
+  type_usew_t<x>::type vs2 = vs2_base[i];
+
+#define VX_PARAMS_BASE(x) \
+  type_sew_t<x>::type *vd_base = VI_GROUP(type_sew_t<x>::type, rd_num, true); \
+  type_sew_t<x>::type *vs2_base = VI_GROUP(type_sew_t<x>::type, rs2_num, false); \
+  const type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1;
+
+#define VX_PARAMS_ELT(x) \
+  type_sew_t<x>::type &vd = vd_base[i]; \
+  type_sew_t<x>::type vs2 = vs2_base[i];
+
+#define VX_U_PARAMS_BASE(x) \
+  type_usew_t<x>::type *vd_base = VI_GROUP(type_usew_t<x>::type, rd_num, true); \
+  type_usew_t<x>::type *vs2_base = VI_GROUP(type_usew_t<x>::type, rs2_num, false); \
+  const type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1;
+
+#define VX_U_PARAMS_ELT(x) \
+  type_usew_t<x>::type &vd = vd_base[i]; \
+  type_usew_t<x>::type vs2 = vs2_base[i];
+
+#define VI_PARAMS_BASE(x) \
+  type_sew_t<x>::type *vd_base = VI_GROUP(type_sew_t<x>::type, rd_num, true); \
+  type_sew_t<x>::type *vs2_base = VI_GROUP(type_sew_t<x>::type, rs2_num, false); \
+  const type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5();
+
+#define VI_PARAMS_ELT(x) \
+  type_sew_t<x>::type &vd = vd_base[i]; \
+  type_sew_t<x>::type vs2 = vs2_base[i];
+
+#define VI_U_PARAMS_BASE(x) \
+  type_usew_t<x>::type *vd_base = VI_GROUP(type_usew_t<x>::type, rd_num, true); \
+  type_usew_t<x>::type *vs2_base = VI_GROUP(type_usew_t<x>::type, rs2_num, false); \
+  const type_usew_t<x>::type zimm5 = (type_usew_t<x>::type)insn.v_zimm5();
+
+#define VI_U_PARAMS_ELT(x) \
+  type_usew_t<x>::type &vd = vd_base[i]; \
+  type_usew_t<x>::type vs2 = vs2_base[i];
+
+#define VXI_PARAMS_BASE(x) \
+  VV_PARAMS_BASE(x) \
+  const type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1; \
+  const type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5();
+
+#define VXI_PARAMS_ELT(x) \
+  VV_PARAMS_ELT(x)
+
+#define VV_CMP_PARAMS_BASE(x) \
+  type_sew_t<x>::type *vs1_base = VI_GROUP(type_sew_t<x>::type, rs1_num, false); \
+  type_sew_t<x>::type *vs2_base = VI_GROUP(type_sew_t<x>::type, rs2_num, false);
+
+#define VV_CMP_PARAMS_ELT(x) \
+  type_sew_t<x>::type vs1 = vs1_base[i]; \
+  type_sew_t<x>::type vs2 = vs2_base[i];
+
+#define VV_UCMP_PARAMS_BASE(x) \
+  type_usew_t<x>::type *vs1_base = VI_GROUP(type_usew_t<x>::type, rs1_num, false); \
+  type_usew_t<x>::type *vs2_base = VI_GROUP(type_usew_t<x>::type, rs2_num, false);
+
+#define VV_UCMP_PARAMS_ELT(x) \
+  type_usew_t<x>::type vs1 = vs1_base[i]; \
+  type_usew_t<x>::type vs2 = vs2_base[i];
+
+#define VX_CMP_PARAMS_BASE(x) \
+  type_sew_t<x>::type *vs2_base = VI_GROUP(type_sew_t<x>::type, rs2_num, false); \
+  const type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1;
+
+#define VX_CMP_PARAMS_ELT(x) \
+  type_sew_t<x>::type vs2 = vs2_base[i];
+
+#define VX_UCMP_PARAMS_BASE(x) \
+  type_usew_t<x>::type *vs2_base = VI_GROUP(type_usew_t<x>::type, rs2_num, false); \
+  const type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1;
+
+#define VX_UCMP_PARAMS_ELT(x) \
+  type_usew_t<x>::type vs2 = vs2_base[i];
+
+#define VI_CMP_PARAMS_BASE(x) \
+  type_sew_t<x>::type *vs2_base = VI_GROUP(type_sew_t<x>::type, rs2_num, false); \
+  const type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5();
+
+#define VI_CMP_PARAMS_ELT(x) \
+  type_sew_t<x>::type vs2 = vs2_base[i];
+
+#define VI_UCMP_PARAMS_BASE(x) \
+  type_usew_t<x>::type *vs2_base = VI_GROUP(type_usew_t<x>::type, rs2_num, false);
+
+#define VI_UCMP_PARAMS_ELT(x) \
+  type_usew_t<x>::type vs2 = vs2_base[i];
+
+#define VI_HOISTED_BASE \
+  require(P.VU.vsew >= e8 && P.VU.vsew <= e64); \
+  require_vector(true);\
+  reg_t vl = P.VU.vl; \
+  reg_t sew = P.VU.vsew; \
+  reg_t rd_num = insn.rd(); \
+  reg_t rs1_num = insn.rs1(); \
+  reg_t rs2_num = insn.rs2();
+
+#ifdef WORDS_BIGENDIAN
+
+#define VI_HOISTED_LOOP(PARAMS, x, BODY) \
+  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
+    VI_LOOP_ELEMENT_SKIP(); \
+    PARAMS(x); \
     BODY; \
-  }else if(sew == e64){ \
-    VV_CMP_PARAMS(e64); \
+  }
+
+#define VI_HOISTED_GENERAL_LOOP(PARAMS, x, BODY) \
+  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
+    PARAMS(x); \
     BODY; \
-  } \
-  VI_LOOP_CMP_END
+  }
 
-#define VI_VX_LOOP_CMP(BODY) \
-  VI_CHECK_MSS(false); \
-  VI_LOOP_CMP_BASE \
-  if (sew == e8){ \
-    VX_CMP_PARAMS(e8); \
+#define VI_HOISTED_CMP_LOOP(PARAMS, x, BODY) \
+  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
+    VI_LOOP_ELEMENT_SKIP(); \
+    uint64_t mmask = UINT64_C(1) << mpos; \
+    uint64_t &vdi = P.VU.elt<uint64_t>(insn.rd(), midx, true); \
+    uint64_t res = 0; \
+    PARAMS(x); \
     BODY; \
-  }else if(sew == e16){ \
-    VX_CMP_PARAMS(e16); \
+    vdi = (vdi & ~mmask) | (((res) << mpos) & mmask); \
+  }
+
+#else
+
+#define VI_HOISTED_MASK \
+  const uint64_t* vmask = insn.v_vm() ? NULL : \
+    P.VU.elt_group<uint64_t>(0, P.VU.vstart / 64, (vl + 63) / 64);
+
+#define VI_HOISTED_ELEMENT_SKIP \
+  VI_MASK_VARS \
+  if (vmask && ((vmask[midx] >> mpos) & 0x1) == 0) \
+    continue;
+
+#define VI_HOISTED_LOOP(PARAMS, x, BODY) \
+  VI_HOISTED_MASK \
+  PARAMS##_BASE(x) \
+  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
+    VI_HOISTED_ELEMENT_SKIP \
+    PARAMS##_ELT(x); \
     BODY; \
-  }else if(sew == e32){ \
-    VX_CMP_PARAMS(e32); \
+  }
+
+#define VI_HOISTED_GENERAL_LOOP(PARAMS, x, BODY) \
+  PARAMS##_BASE(x) \
+  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
+    PARAMS##_ELT(x); \
     BODY; \
-  }else if(sew == e64){ \
-    VX_CMP_PARAMS(e64); \
+  }
+
+#define VI_HOISTED_CMP_LOOP(PARAMS, x, BODY) \
+  VI_HOISTED_MASK \
+  PARAMS##_BASE(x) \
+  uint64_t* vd_mask = P.VU.elt_group<uint64_t>(rd_num, P.VU.vstart / 64, \
+                                               (vl + 63) / 64, true); \
+  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
+    VI_HOISTED_ELEMENT_SKIP \
+    uint64_t mmask = UINT64_C(1) << mpos; \
+    uint64_t &vdi = vd_mask[midx]; \
+    uint64_t res = 0; \
+    PARAMS##_ELT(x); \
     BODY; \
-  } \
-  VI_LOOP_CMP_END
+    vdi = (vdi & ~mmask) | (((res) << mpos) & mmask); \
+  }
 
-#define VI_VI_LOOP_CMP(BODY) \
-  VI_CHECK_MSS(false); \
-  VI_LOOP_CMP_BASE \
+#endif
+
+// one LOOP per SEW, each with its operand pointers hoisted
+#define VI_LOOP_HOISTED(LOOP, PARAMS, BODY) \
+  VI_HOISTED_BASE \
   if (sew == e8){ \
-    VI_CMP_PARAMS(e8); \
-    BODY; \
+    LOOP(PARAMS, e8, BODY) \
   }else if(sew == e16){ \
-    VI_CMP_PARAMS(e16); \
-    BODY; \
+    LOOP(PARAMS, e16, BODY) \
   }else if(sew == e32){ \
-    VI_CMP_PARAMS(e32); \
-    BODY; \
+    LOOP(PARAMS, e32, BODY) \
   }else if(sew == e64){ \
-    VI_CMP_PARAMS(e64); \
-    BODY; \
+    LOOP(PARAMS, e64, BODY) \
   } \
-  VI_LOOP_CMP_END
+  P.VU.vstart = 0;
+
+//
+// vector: integer and masking operation loop
+//
+
+// comparision result to masking register
+#define VI_VV_LOOP_CMP(BODY) \
+  VI_CHECK_MSS(true); \
+  VI_LOOP_HOISTED(VI_HOISTED_CMP_LOOP, VV_CMP_PARAMS, BODY)
+
+#define VI_VX_LOOP_CMP(BODY) \
+  VI_CHECK_MSS(false); \
+  VI_LOOP_HOISTED(VI_HOISTED_CMP_LOOP, VX_CMP_PARAMS, BODY)
+
+#define VI_VI_LOOP_CMP(BODY) \
+  VI_CHECK_MSS(false); \
+  VI_LOOP_HOISTED(VI_HOISTED_CMP_LOOP, VI_CMP_PARAMS, BODY)
 
 #define VI_VV_ULOOP_CMP(BODY) \
   VI_CHECK_MSS(true); \
-  VI_LOOP_CMP_BASE \
-  if (sew == e8){ \
-    VV_UCMP_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VV_UCMP_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VV_UCMP_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VV_UCMP_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_CMP_END
+  VI_LOOP_HOISTED(VI_HOISTED_CMP_LOOP, VV_UCMP_PARAMS, BODY)
 
 #define VI_VX_ULOOP_CMP(BODY) \
   VI_CHECK_MSS(false); \
-  VI_LOOP_CMP_BASE \
-  if (sew == e8){ \
-    VX_UCMP_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VX_UCMP_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VX_UCMP_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VX_UCMP_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_CMP_END
+  VI_LOOP_HOISTED(VI_HOISTED_CMP_LOOP, VX_UCMP_PARAMS, BODY)
 
 #define VI_VI_ULOOP_CMP(BODY) \
   VI_CHECK_MSS(false); \
-  VI_LOOP_CMP_BASE \
-  if (sew == e8){ \
-    VI_UCMP_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VI_UCMP_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VI_UCMP_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VI_UCMP_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_CMP_END
+  VI_LOOP_HOISTED(VI_HOISTED_CMP_LOOP, VI_UCMP_PARAMS, BODY)
 
 // merge and copy loop
 #define VI_VVXI_MERGE_LOOP(BODY) \
-  VI_GENERAL_LOOP_BASE \
-  if (sew == e8){ \
-    VXI_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VXI_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VXI_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VXI_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_LOOP_HOISTED(VI_HOISTED_GENERAL_LOOP, VXI_PARAMS, BODY)
 
 // reduction loop - signed
 #define VI_LOOP_REDUCTION_BASE(x) \
@@ -1027,111 +1137,171 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 // genearl VXI signed/unsgied loop
 #define VI_VV_ULOOP(BODY) \
   VI_CHECK_SSS(true) \
-  VI_LOOP_BASE \
-  if (sew == e8){ \
-    VV_U_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VV_U_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VV_U_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VV_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_LOOP_HOISTED(VI_HOISTED_LOOP, VV_U_PARAMS, BODY)
 
 #define VI_VV_LOOP(BODY) \
   VI_CHECK_SSS(true) \
-  VI_LOOP_BASE \
-  if (sew == e8){ \
-    VV_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VV_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VV_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VV_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_LOOP_HOISTED(VI_HOISTED_LOOP, VV_PARAMS, BODY)
 
 #define VI_VX_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8){ \
-    VX_U_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VX_U_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VX_U_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VX_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_LOOP_HOISTED(VI_HOISTED_LOOP, VX_U_PARAMS, BODY)
 
 #define VI_VX_LOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8){ \
-    VX_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VX_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VX_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VX_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_LOOP_HOISTED(VI_HOISTED_LOOP, VX_PARAMS, BODY)
 
 #define VI_VI_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8){ \
-    VI_U_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VI_U_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VI_U_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VI_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_LOOP_HOISTED(VI_HOISTED_LOOP, VI_U_PARAMS, BODY)
 
 #define VI_VI_LOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8){ \
-    VI_PARAMS(e8); \
-    BODY; \
-  }else if(sew == e16){ \
-    VI_PARAMS(e16); \
-    BODY; \
-  }else if(sew == e32){ \
-    VI_PARAMS(e32); \
-    BODY; \
-  }else if(sew == e64){ \
-    VI_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_LOOP_HOISTED(VI_HOISTED_LOOP, VI_PARAMS, BODY)
+
+//
+// vector: host SIMD loops
+//
+// The *_HOST loops run an instruction through a kernel from
+// vector_kernels.h when vstart is zero, and otherwise (and on big-endian
+// hosts) fall back to the equivalent element loop with BODY.  The kernel
+// call is expanded once per SEW with T naming the unsigned element type.
+//
+#define VI_HOST_CHECK \
+  require(P.VU.vsew >= e8 && P.VU.vsew <= e64); \
+  require_vector(true);
+
+#ifdef WORDS_BIGENDIAN
+# define VI_HOST_KERNEL(CALL) false
+#else
+# define VI_HOST_KERNEL(CALL) \
+  ({ \
+    bool host_done = false; \
+    const reg_t vl = P.VU.vl; \
+    if (P.VU.vstart == 0) { \
+      const uint64_t* vmask = insn.v_vm() ? NULL : \
+        P.VU.elt_group<uint64_t>(0, 0, (vl + 63) / 64); \
+      switch (P.VU.vsew) { \
+        case e8: { typedef uint8_t T; CALL; break; } \
+        case e16: { typedef uint16_t T; CALL; break; } \
+        case e32: { typedef uint32_t T; CALL; break; } \
+        default: { typedef uint64_t T; CALL; break; } \
+      } \
+      host_done = true; \
+    } \
+    host_done; \
+  })
+#endif
+
+#define VI_HOST_VS1(is_vs1) \
+  (is_vs1 ? P.VU.elt_group<T>(insn.rs1(), 0, vl) : NULL)
+
+#define VI_HOST_BINARY(OP, is_vs1, x) \
+  VI_HOST_KERNEL((vk_binary(P.VU.elt_group<T>(insn.rd(), 0, vl, true), \
+    P.VU.elt_group<T>(insn.rs2(), 0, vl), VI_HOST_VS1(is_vs1), (T)(x), \
+    vl, vmask, OP())))
+
+#define VI_HOST_COMPARE(OP, is_vs1, x) \
+  VI_HOST_KERNEL((vk_compare( \
+    P.VU.elt_group<uint64_t>(insn.rd(), 0, (vl + 63) / 64, true), \
+    P.VU.elt_group<T>(insn.rs2(), 0, vl), VI_HOST_VS1(is_vs1), (T)(x), \
+    vl, vmask, OP())))
+
+#define VI_HOST_MERGE(is_vs1, x) \
+  VI_HOST_KERNEL((vk_merge(P.VU.elt_group<T>(insn.rd(), 0, vl, true), \
+    P.VU.elt_group<T>(insn.rs2(), 0, vl), VI_HOST_VS1(is_vs1), (T)(x), \
+    vl, vmask)))
+
+#define VI_VV_LOOP_HOST(OP, BODY) \
+  VI_CHECK_SSS(true) \
+  VI_HOST_CHECK \
+  if (!VI_HOST_BINARY(OP, true, 0)) { \
+    VI_VV_LOOP(BODY) \
+  }
+
+#define VI_VV_ULOOP_HOST(OP, BODY) \
+  VI_CHECK_SSS(true) \
+  VI_HOST_CHECK \
+  if (!VI_HOST_BINARY(OP, true, 0)) { \
+    VI_VV_ULOOP(BODY) \
+  }
+
+#define VI_VX_LOOP_HOST(OP, BODY) \
+  VI_CHECK_SSS(false) \
+  VI_HOST_CHECK \
+  if (!VI_HOST_BINARY(OP, false, RS1)) { \
+    VI_VX_LOOP(BODY) \
+  }
+
+#define VI_VX_ULOOP_HOST(OP, BODY) \
+  VI_CHECK_SSS(false) \
+  VI_HOST_CHECK \
+  if (!VI_HOST_BINARY(OP, false, RS1)) { \
+    VI_VX_ULOOP(BODY) \
+  }
+
+#define VI_VI_LOOP_HOST(OP, imm, BODY) \
+  VI_CHECK_SSS(false) \
+  VI_HOST_CHECK \
+  if (!VI_HOST_BINARY(OP, false, imm)) { \
+    VI_VI_LOOP(BODY) \
+  }
+
+#define VI_VI_ULOOP_HOST(OP, imm, BODY) \
+  VI_CHECK_SSS(false) \
+  VI_HOST_CHECK \
+  if (!VI_HOST_BINARY(OP, false, imm)) { \
+    VI_VI_ULOOP(BODY) \
+  }
+
+#define VI_VV_LOOP_CMP_HOST(OP, BODY) \
+  VI_CHECK_MSS(true); \
+  VI_HOST_CHECK \
+  if (!VI_HOST_COMPARE(OP, true, 0)) { \
+    VI_VV_LOOP_CMP(BODY) \
+  }
+
+#define VI_VV_ULOOP_CMP_HOST(OP, BODY) \
+  VI_CHECK_MSS(true); \
+  VI_HOST_CHECK \
+  if (!VI_HOST_COMPARE(OP, true, 0)) { \
+    VI_VV_ULOOP_CMP(BODY) \
+  }
+
+#define VI_VX_LOOP_CMP_HOST(OP, BODY) \
+  VI_CHECK_MSS(false); \
+  VI_HOST_CHECK \
+  if (!VI_HOST_COMPARE(OP, false, RS1)) { \
+    VI_VX_LOOP_CMP(BODY) \
+  }
+
+#define VI_VX_ULOOP_CMP_HOST(OP, BODY) \
+  VI_CHECK_MSS(false); \
+  VI_HOST_CHECK \
+  if (!VI_HOST_COMPARE(OP, false, RS1)) { \
+    VI_VX_ULOOP_CMP(BODY) \
+  }
+
+#define VI_VI_LOOP_CMP_HOST(OP, BODY) \
+  VI_CHECK_MSS(false); \
+  VI_HOST_CHECK \
+  if (!VI_HOST_COMPARE(OP, false, insn.v_simm5())) { \
+    VI_VI_LOOP_CMP(BODY) \
+  }
+
+#define VI_VI_ULOOP_CMP_HOST(OP, BODY) \
+  VI_CHECK_MSS(false); \
+  VI_HOST_CHECK \
+  if (!VI_HOST_COMPARE(OP, false, insn.v_simm5())) { \
+    VI_VI_ULOOP_CMP(BODY) \
+  }
+
+// vmerge and vmv.v: every element is taken from vs1/rs1/imm unless masked
+#define VI_VVXI_MERGE_LOOP_HOST(is_vs1, x, BODY) \
+  VI_HOST_CHECK \
+  if (!VI_HOST_MERGE(is_vs1, x)) { \
+    VI_VVXI_MERGE_LOOP(BODY) \
+  }
 
 // narrow operation loop
 #define VI_VV_LOOP_NARROW(BODY) \
@@ -1610,19 +1780,90 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   } \
 }
 
+//
+// Unit-stride and strided accesses whose elements all fall within one page
+// already resident in the TLB are copied directly between guest memory and
+// the register file: a single memcpy for an unmasked, non-segment,
+// unit-stride access, or an element loop over the host page otherwise.
+// Anything else (page crossings, TLB misses, misalignment, triggers,
+// memtracers) is left to the element-wise loop.  On return vstart is vl if
+// the bulk path completed the access.  elt_addr(i, fn) must be affine in i.
+//
+#ifdef WORDS_BIGENDIAN
+# define VI_LDST_BULK(elt_width, type, vreg, COPY, LOG)
+#else
+# define VI_LDST_BULK(elt_width, type, vreg, COPY, LOG) \
+  if (P.VU.vstart < vl) { \
+    const reg_t esz = sizeof(elt_width##_t); \
+    const reg_t start = P.VU.vstart; \
+    const reg_t first = elt_addr(start, 0); \
+    const reg_t last = elt_addr(vl - 1, 0); \
+    const reg_t seg = nf * esz; \
+    const reg_t step = vl - start > 1 ? elt_addr(start + 1, 0) - first : seg; \
+    const reg_t lo = std::min(first, last); \
+    const reg_t len = std::max(first, last) + seg - lo; \
+    /* overlapping segments would be accessed out of order */ \
+    const bool overlap = nf > 1 && step + seg - 1 < 2 * seg - 1; \
+    char* host = ((first | step) & (esz - 1)) || overlap ? NULL : \
+      MMU.bulk_host_addr(lo, len, type); \
+    if (host) { \
+      const uint64_t* vmask = insn.v_vm() ? NULL : \
+        P.VU.elt_group<uint64_t>(0, start / 64, (vl + 63) / 64); \
+      for (reg_t fn = 0; fn < nf; ++fn) { \
+        elt_width##_t* vp = P.VU.elt_group<elt_width##_t>( \
+          vreg + fn * emul, start, vl, type == LOAD); \
+        if (!vmask && nf == 1 && step == esz) { \
+          elt_width##_t* mp = (elt_width##_t*)(host + (first - lo)); \
+          elt_width##_t* rp = vp + start; \
+          reg_t n = vl - start; \
+          COPY; \
+        } else { \
+          for (reg_t i = start; i < vl; ++i) { \
+            if (vmask && ((vmask[i / 64] >> (i % 64)) & 1) == 0) \
+              continue; \
+            elt_width##_t* mp = (elt_width##_t*)(host + (elt_addr(i, fn) - lo)); \
+            elt_width##_t* rp = vp + i; \
+            reg_t n = 1; \
+            COPY; \
+          } \
+        } \
+      } \
+      VI_LDST_BULK_LOG(LOG); \
+      P.VU.vstart = vl; \
+    } \
+  }
+#endif
+
+#ifdef RISCV_ENABLE_COMMITLOG
+# define VI_LDST_BULK_LOG(LOG) \
+  for (reg_t i = start; i < vl; ++i) { \
+    if (vmask && ((vmask[i / 64] >> (i % 64)) & 1) == 0) \
+      continue; \
+    for (reg_t fn = 0; fn < nf; ++fn) \
+      LOG; \
+  }
+#else
+# define VI_LDST_BULK_LOG(LOG)
+#endif
+
 #define VI_LD(stride, offset, elt_width) \
   const reg_t nf = insn.v_nf() + 1; \
   const reg_t vl = P.VU.vl; \
   const reg_t baseAddr = RS1; \
   const reg_t vd = insn.rd(); \
   VI_CHECK_LOAD(elt_width); \
-  for (reg_t i = 0; i < vl; ++i) { \
+  auto elt_addr = [&](reg_t i, reg_t fn) -> reg_t { \
+    return baseAddr + (stride) + (offset) * sizeof(elt_width##_t); \
+  }; \
+  VI_LDST_BULK(elt_width, LOAD, vd, \
+    memcpy(rp, mp, n * esz), \
+    STATE.log_mem_read.push_back(std::make_tuple(elt_addr(i, fn), 0, esz))); \
+  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
     VI_ELEMENT_SKIP(i); \
     VI_STRIP(i); \
     P.VU.vstart = i; \
     for (reg_t fn = 0; fn < nf; ++fn) { \
-      elt_width##_t val = MMU.load_##elt_width( \
-        baseAddr + (stride) + (offset) * sizeof(elt_width##_t)); \
+      elt_width##_t val = MMU.load_##elt_width(elt_addr(i, fn)); \
       P.VU.elt<elt_width##_t>(vd + fn * emul, vreg_inx, true) = val; \
     } \
   } \
@@ -1670,14 +1911,20 @@ for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl != 0; ++i) { \
   const reg_t baseAddr = RS1; \
   const reg_t vs3 = insn.rd(); \
   VI_CHECK_STORE(elt_width); \
-  for (reg_t i = 0; i < vl; ++i) { \
+  auto elt_addr = [&](reg_t i, reg_t fn) -> reg_t { \
+    return baseAddr + (stride) + (offset) * sizeof(elt_width##_t); \
+  }; \
+  VI_LDST_BULK(elt_width, STORE, vs3, \
+    memcpy(mp, rp, n * esz), \
+    STATE.log_mem_write.push_back(std::make_tuple(elt_addr(i, fn), \
+      P.VU.elt<elt_width##_t>(vs3 + fn * emul, i), esz))); \
+  for (reg_t i = P.VU.vstart; i < vl; ++i) { \
     VI_STRIP(i) \
     VI_ELEMENT_SKIP(i); \
     P.VU.vstart = i; \
     for (reg_t fn = 0; fn < nf; ++fn) { \
       elt_width##_t val = P.VU.elt<elt_width##_t>(vs3 + fn * emul, vreg_inx); \
-      MMU.store_##elt_width( \
-        baseAddr + (stride) + (offset) * sizeof(elt_width##_t), val); \
+      MMU.store_##elt_width(elt_addr(i, fn), val); \
     } \
   } \
   P.VU.vstart = 0;
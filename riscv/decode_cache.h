@@ -0,0 +1,44 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_DECODE_CACHE_H
+#define _RISCV_DECODE_CACHE_H
+
+#include "decode.h"
+#include "processor.h"
+
+// A decoded-instruction cache indexed by physical address.  It sits behind
+// the per-hart (virtually-indexed) icache in mmu_t and may be shared by all
+// harts that use the same instruction tables, so that code run by several
+// harts is only decoded once.  Each entry remembers the instruction bits it
+// was decoded from; a lookup whose bits differ (e.g. after the code has been
+// rewritten) simply misses.
+struct decode_cache_entry_t {
+  reg_t paddr;
+  insn_bits_t bits;
+  insn_func_t rv32;
+  insn_func_t rv64;
+};
+
+class decode_cache_t
+{
+public:
+  static const reg_t ENTRIES = 16384;
+
+  decode_cache_t() { flush(); }
+
+  void flush()
+  {
+    for (size_t i = 0; i < ENTRIES; i++)
+      entries[i].paddr = -1;
+  }
+
+  inline decode_cache_entry_t* lookup(reg_t paddr)
+  {
+    return &entries[(paddr / PC_ALIGN) % ENTRIES];
+  }
+
+private:
+  decode_cache_entry_t entries[ENTRIES];
+};
+
+#endif
@@ -0,0 +1,78 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_DETAIL_H
+#define _RISCV_DETAIL_H
+
+// Switching between fast-forward and detailed simulation.  Cache models and
+// other memtracers are called on every access they are interested in, and
+// the instruction and commit logs take the slow path of the execution loop,
+// so a run can fast-forward with them detached until a trigger fires, then
+// simulate a region of interest in detail.
+
+#include "memtracer.h"
+#include "decode.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Markers are the hint slti x0, x0, imm, which programs can place around a
+// region of interest.
+#define DETAIL_MARKER_START 1
+#define DETAIL_MARKER_STOP  2
+
+struct detail_trigger_t
+{
+  enum kind_t {
+    NONE,
+    INSTRET,   // hart 0 has retired value instructions
+    PC,        // hart 0 is about to execute the instruction at virtual pc value
+    MARKER,    // any hart executes a start, or for a stop trigger a stop, marker
+  } kind;
+  reg_t value;
+
+  detail_trigger_t() : kind(NONE), value(0) {}
+
+  // Parse instret:<n>, pc:<address> or marker; false if s is none of those.
+  bool parse(const char* s)
+  {
+    char* end;
+    if (strcmp(s, "marker") == 0) {
+      kind = MARKER;
+      value = 0;
+      return true;
+    }
+    if (strncmp(s, "instret:", 8) == 0) {
+      kind = INSTRET;
+      s += 8;
+    } else if (strncmp(s, "pc:", 3) == 0) {
+      kind = PC;
+      s += 3;
+    } else {
+      return false;
+    }
+    value = strtoull(s, &end, 0);
+    return *s != 0 && *end == 0;
+  }
+};
+
+// Forwards accesses to the tracers in list while enabled, and is interested
+// in none otherwise.  The harts' TLBs must be flushed after enabled changes.
+class detail_tracer_t : public memtracer_t
+{
+ public:
+  detail_tracer_t() : enabled(false) {}
+
+  bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
+  {
+    return enabled && list.interested_in_range(begin, end, type);
+  }
+  void trace(uint64_t addr, size_t bytes, access_type type)
+  {
+    if (enabled)
+      list.trace(addr, bytes, type);
+  }
+
+  memtracer_list_t list;
+  bool enabled;
+};
+
+#endif
@@ -10,6 +10,7 @@
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
+#include <chrono>
 
 class processor_t;
 
@@ -64,6 +65,11 @@ class mem_t : public abstract_device_t {
   size_t len;
 };
 
+// register offsets from CLINT_BASE
+#define MSIP_BASE	0x0
+#define MTIMECMP_BASE	0x4000
+#define MTIME_BASE	0xbff8
+
 class clint_t : public abstract_device_t {
  public:
   clint_t(std::vector<processor_t*>&, uint64_t freq_hz, bool real_time);
@@ -72,6 +78,14 @@ class clint_t : public abstract_device_t {
   size_t size() { return CLINT_SIZE; }
   void increment(reg_t inc);
   uint64_t get_mtime() {return mtime;}
+
+  // state saved and restored by sim_t snapshots
+  struct snapshot_t {
+    uint64_t mtime;
+    std::vector<uint64_t> mtimecmp;
+  };
+  snapshot_t save() const { return {mtime, mtimecmp}; }
+  void restore(const snapshot_t& s) { mtime = s.mtime; mtimecmp = s.mtimecmp; }
  private:
   typedef uint64_t mtime_t;
   typedef uint64_t mtimecmp_t;
@@ -97,6 +111,26 @@ class plic_t : public abstract_device_t {
   void plic_update();
   bool plic_int_check(uint32_t contextid);
   void plic_irq (uint32_t irq, bool level);
+
+  // state saved and restored by sim_t snapshots
+  struct snapshot_t {
+    std::vector<uint32_t> priority;
+    std::vector<std::vector<uint32_t> > ie;
+    std::vector<uint32_t> ip;
+    std::vector<uint32_t> threshold;
+    std::vector<std::vector<uint32_t> > claimed;
+    std::vector<uint32_t> level;
+  };
+  snapshot_t save() const { return {priority, ie, ip, threshold, claimed, level}; }
+  void restore(const snapshot_t& s)
+  {
+    priority = s.priority;
+    ie = s.ie;
+    ip = s.ip;
+    threshold = s.threshold;
+    claimed = s.claimed;
+    level = s.level;
+  }
  private:
   size_t num_source;
   size_t num_context;
@@ -107,6 +141,7 @@ class plic_t : public abstract_device_t {
   std::vector<plic_reg_t> ip;
   std::vector<plic_reg_t> threshold;
   std::vector<std::vector<plic_reg_t> > claimed;
+  std::vector<plic_reg_t> level; // input level of each source
 
   typedef struct {
     uint32_t hartid;
@@ -118,11 +153,30 @@ class plic_t : public abstract_device_t {
 class uart_t : public abstract_device_t {
  public:
   uart_t(plic_t* plic ,bool diffTest, std::string file_path);
+  ~uart_t();
   bool load(reg_t addr, size_t len, uint8_t* bytes);
   bool store(reg_t addr, size_t len, const uint8_t* bytes);
   size_t size() { return UART_SIZE; }
   void check_int();
 
+  // state saved and restored by sim_t snapshots; input already read from
+  // the FIFO is not given back
+  struct snapshot_t {
+    uint8_t ier, isr, fcr, lcr, mcr, msr, spr, dll, dlm, psd;
+    bool irq_level;
+  };
+  snapshot_t save() const
+  {
+    return {uart_ier, uart_isr, uart_fcr, uart_lcr, uart_mcr,
+            uart_msr, uart_spr, uart_dll, uart_dlm, uart_psd, irq_level};
+  }
+  void restore(const snapshot_t& s)
+  {
+    uart_ier = s.ier; uart_isr = s.isr; uart_fcr = s.fcr; uart_lcr = s.lcr;
+    uart_mcr = s.mcr; uart_msr = s.msr; uart_spr = s.spr; uart_dll = s.dll;
+    uart_dlm = s.dlm; uart_psd = s.psd; irq_level = s.irq_level;
+  }
+
  private:
   bool diffTest;
   plic_t* plic;
@@ -137,6 +191,27 @@ class uart_t : public abstract_device_t {
   uint8_t uart_dll;
   uint8_t uart_dlm;
   uint8_t uart_psd;
+
+  // Host input is read in bulk, when check_int() finds some waiting, into
+  // a ring that the guest reads from.  stdin is only polled every
+  // millisecond or so, rather than on every call.  Output is buffered
+  // until a newline, or until it has waited a few milliseconds.  The
+  // interrupt line goes to the PLIC only when its level changes.
+  static const size_t rx_size = 1024;
+  static const size_t tx_size = 4096;
+  uint8_t rx_buf[rx_size];
+  size_t rx_head, rx_count;
+  bool stdin_eof;
+  std::chrono::steady_clock::time_point rx_polled;
+  std::string tx_buf;
+  std::chrono::steady_clock::time_point tx_since;
+  bool irq_level;
+
+  bool rx_ready();
+  uint8_t rx_get();
+  void poll_stdin();
+  void tx_put(uint8_t c);
+  void flush_tx();
 };
 
 #endif
@@ -0,0 +1,46 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_DIRTY_LOG_H
+#define _RISCV_DIRTY_LOG_H
+
+#include "memtracer.h"
+#include "mmu.h"
+#include <set>
+#include <vector>
+
+// Records the pages of memory that the harts store to, so that another
+// model of the same memory can copy just those.  Stores to a page are
+// traced until the first one, which logs it; the TLBs cache that the page
+// is no longer of interest, so they must be flushed once it is taken from
+// the log for it to be caught again.
+class dirty_log_t : public memtracer_t
+{
+ public:
+  bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
+  {
+    return type == STORE && !pages.count(begin >> PGSHIFT);
+  }
+  void trace(uint64_t addr, size_t bytes, access_type type)
+  {
+    if (type == STORE)
+      pages.insert(addr >> PGSHIFT);
+  }
+
+  // Remove up to max pages from the log, lowest address first, and return
+  // their addresses.
+  std::vector<reg_t> take(size_t max)
+  {
+    std::vector<reg_t> taken;
+    auto it = pages.begin();
+    for (; it != pages.end() && taken.size() < max; ++it)
+      taken.push_back(*it << PGSHIFT);
+    pages.erase(pages.begin(), it);
+    return taken;
+  }
+  void clear() { pages.clear(); }
+
+ private:
+  std::set<reg_t> pages;
+};
+
+#endif
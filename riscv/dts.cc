@@ -132,6 +132,13 @@ std::string make_dts(size_t insns_per_rtc_tick, size_t cpu_hz,
 
 std::string dts_compile(const std::string& dts)
 {
+  // A process often builds the same machine over and over, e.g. a difftest
+  // testbench running one test after another, so remember the last result
+  // rather than running dtc again.
+  static std::string last_dts, last_dtb;
+  if (!last_dtb.empty() && dts == last_dts)
+    return last_dtb;
+
   // Convert the DTS to DTB
   int dts_pipe[2];
   pid_t dts_pid;
@@ -209,7 +216,9 @@ std::string dts_compile(const std::string& dts)
     exit(1);
   }
 
-  return dtb.str();
+  last_dts = dts;
+  last_dtb = dtb.str();
+  return last_dtb;
 }
 
 
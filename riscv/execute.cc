@@ -3,6 +3,7 @@
 #include "processor.h"
 #include "mmu.h"
 #include "disasm.h"
+#include "bbv.h"
 #include <cassert>
 
 #ifdef RISCV_ENABLE_COMMITLOG
@@ -224,6 +225,7 @@ void processor_t::step(size_t n, bool check_int)
 
   while (n > 0) {
     size_t instret = 0;
+    size_t bbv_mark = 0;
     reg_t pc = state.pc;
     mmu_t* _mmu = mmu;
 
@@ -242,6 +244,24 @@ void processor_t::step(size_t n, bool check_int)
        instret++; \
      }
 
+    // Basic block vectors are counted a run of instructions at a time: a
+    // run starts at bbv_fetch() and, once the last of them has returned
+    // npc, bbv_retire() counts those that retired toward the current block.
+    #define bbv_fetch() \
+     if (unlikely(bbv != NULL)) { \
+       bbv->fetch(pc); \
+       bbv_mark = instret; \
+     }
+
+    #define bbv_retire(npc) \
+     if (unlikely(bbv != NULL)) { \
+       bool retired = npc != PC_SERIALIZE_BEFORE; \
+       insn_t last(state.last_inst); \
+       bbv->retire(instret - bbv_mark + retired, \
+                   state.last_pc + (retired ? last.length() : 0)); \
+       bbv_mark = instret + retired; \
+     }
+
     try
     {
       if (check_int)
@@ -267,7 +287,9 @@ void processor_t::step(size_t n, bool check_int)
           insn_fetch_t fetch = mmu->load_insn(pc);
           if (debug && !state.serialized)
             disasm(fetch.insn);
+          bbv_fetch();
           pc = execute_insn(this, pc, fetch);
+          bbv_retire(pc);
           advance_pc();
         }
       }
@@ -296,6 +318,7 @@ void processor_t::step(size_t n, bool check_int)
         // return the correct entry. ic_entry->data.func is the C++ function
         // corresponding to the instruction.
         auto ic_entry = _mmu->access_icache(pc);
+        bbv_fetch();
 
         // This macro is included in "icache.h" included within the switch
         // statement below. The indirect jump corresponding to the instruction
@@ -318,11 +341,14 @@ void processor_t::step(size_t n, bool check_int)
           #include "icache.h"
         }
 
+        bbv_retire(pc);
         advance_pc();
       }
     }
     catch(trap_t& t)
     {
+      if (unlikely(bbv != NULL))
+        bbv->retire(instret - bbv_mark, reg_t(-1));
       take_trap(t, pc);
 
       n = instret;
@@ -347,6 +373,8 @@ void processor_t::step(size_t n, bool check_int)
         delete mmu->matched_trigger;
         mmu->matched_trigger = NULL;
       }
+      if (unlikely(bbv != NULL))
+        bbv->retire(instret - bbv_mark, reg_t(-1));
       switch (state.mcontrol[t.index].action) {
         case ACTION_DEBUG_MODE:
           enter_debug_mode(DCSR_CAUSE_HWBP);
@@ -368,6 +396,8 @@ void processor_t::step(size_t n, bool check_int)
       // In the debug ROM this prevents us from wasting time looping, but also
       // allows us to switch to other threads only once per idle loop in case
       // there is activity.
+      if (unlikely(bbv != NULL))
+        bbv->retire(instret - bbv_mark, reg_t(-1));
       n = instret;
     }
 
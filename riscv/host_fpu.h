@@ -0,0 +1,217 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_HOST_FPU_H
+#define _RISCV_HOST_FPU_H
+
+// Single- and double-precision arithmetic on the host FPU.  Each host_fNN_op()
+// returns exactly what softfloat's fNN_op() would, and raises the same flags
+// in softfloat_exceptionFlags.  With --enable-host-fpu, the operation runs
+// on the host in softfloat_roundingMode (through fesetround) and the host's
+// exception flags are copied over.  Softfloat does the work instead when the
+// host cannot be trusted to agree with RISC-V:
+//
+//  - a NaN operand or result, because RISC-V produces the canonical NaN and
+//    hosts do not;
+//  - round_near_maxMag, which IEEE hosts do not have;
+//  - a tiny or underflowing result, because hosts may detect tininess before
+//    rounding where RISC-V detects it after;
+//  - fused multiply-add, unless the compiler targets a host FMA instruction
+//    for that precision (FP_FAST_FMAF for single, FP_FAST_FMA for double);
+//  - hosts that evaluate float expressions in extended precision.
+//
+// Without --enable-host-fpu these are plain calls to softfloat.
+
+#include "decode.h"
+#include "softfloat.h"
+#include <cfloat>
+#include <cmath>
+#include <cfenv>
+#include <string.h>
+
+#if defined(RISCV_ENABLE_HOST_FPU) && FLT_EVAL_METHOD == 0
+# define HOST_FPU 1
+#endif
+
+#ifdef HOST_FPU
+
+// keep the compiler from moving host arithmetic across the fenv calls
+#define HOST_FPU_BARRIER(x) __asm__ __volatile__("" : "+m"(x) : : "memory")
+
+template<class S> struct host_fpu_t;
+
+template<> struct host_fpu_t<float32_t> {
+  typedef float type;
+  typedef uint32_t bits;
+  static const bits exp_mask = 0x7f800000;
+  static const bits frac_mask = 0x007fffff;
+  static const bits min_normal = 0x00800000;
+};
+
+template<> struct host_fpu_t<float64_t> {
+  typedef double type;
+  typedef uint64_t bits;
+  static const bits exp_mask = UINT64_C(0x7ff0000000000000);
+  static const bits frac_mask = UINT64_C(0x000fffffffffffff);
+  static const bits min_normal = UINT64_C(0x0010000000000000);
+};
+
+template<class S>
+static inline bool host_fpu_is_nan(S x)
+{
+  typedef host_fpu_t<S> F;
+  return (x.v & F::exp_mask) == F::exp_mask && (x.v & F::frac_mask);
+}
+
+// nonzero and no larger than the smallest normal number
+template<class S>
+static inline bool host_fpu_is_tiny(S x)
+{
+  typedef host_fpu_t<S> F;
+  typename F::bits mag = x.v & (F::exp_mask | F::frac_mask);
+  return mag != 0 && mag <= F::min_normal;
+}
+
+template<class S>
+static inline typename host_fpu_t<S>::type host_fpu_from(S x)
+{
+  typename host_fpu_t<S>::type h;
+  memcpy(&h, &x.v, sizeof(h));
+  return h;
+}
+
+template<class S>
+static inline S host_fpu_to(typename host_fpu_t<S>::type h)
+{
+  S x;
+  memcpy(&x.v, &h, sizeof(h));
+  return x;
+}
+
+static inline int host_fpu_round()
+{
+  switch (softfloat_roundingMode) {
+    case softfloat_round_near_even: return FE_TONEAREST;
+    case softfloat_round_minMag: return FE_TOWARDZERO;
+    case softfloat_round_min: return FE_DOWNWARD;
+    case softfloat_round_max: return FE_UPWARD;
+    default: return -1;
+  }
+}
+
+static inline uint_fast8_t host_fpu_flags(int ex)
+{
+  return (ex & FE_INEXACT ? softfloat_flag_inexact : 0) |
+         (ex & FE_UNDERFLOW ? softfloat_flag_underflow : 0) |
+         (ex & FE_OVERFLOW ? softfloat_flag_overflow : 0) |
+         (ex & FE_DIVBYZERO ? softfloat_flag_infinite : 0) |
+         (ex & FE_INVALID ? softfloat_flag_invalid : 0);
+}
+
+// Run op() on the host.  Returns false, leaving *res and the flags alone,
+// if softfloat has to compute the result instead.
+template<class S, class OP>
+static inline bool host_fpu_run(S* res, OP op)
+{
+  int rm = host_fpu_round();
+  if (rm < 0)
+    return false;
+
+  if (rm != FE_TONEAREST)
+    fesetround(rm);
+  feclearexcept(FE_ALL_EXCEPT);
+  typename host_fpu_t<S>::type h = op();
+  HOST_FPU_BARRIER(h);
+  int ex = fetestexcept(FE_ALL_EXCEPT);
+  if (rm != FE_TONEAREST)
+    fesetround(FE_TONEAREST);
+
+  S r = host_fpu_to<S>(h);
+  if ((ex & FE_UNDERFLOW) || host_fpu_is_nan(r) || host_fpu_is_tiny(r))
+    return false;
+
+  softfloat_exceptionFlags |= host_fpu_flags(ex);
+  *res = r;
+  return true;
+}
+
+#define HOST_FPU_BINARY(S, name, expr) \
+  static inline S host_##name(S a, S b) \
+  { \
+    S r; \
+    if (!host_fpu_is_nan(a) && !host_fpu_is_nan(b) && \
+        host_fpu_run(&r, [=]() { \
+          host_fpu_t<S>::type x = host_fpu_from(a), y = host_fpu_from(b); \
+          HOST_FPU_BARRIER(x); \
+          HOST_FPU_BARRIER(y); \
+          return expr; \
+        })) \
+      return r; \
+    return name(a, b); \
+  }
+
+#define HOST_FPU_SQRT(S, name, fn) \
+  static inline S host_##name(S a) \
+  { \
+    S r; \
+    if (!host_fpu_is_nan(a) && \
+        host_fpu_run(&r, [=]() { \
+          host_fpu_t<S>::type x = host_fpu_from(a); \
+          HOST_FPU_BARRIER(x); \
+          return fn(x); \
+        })) \
+      return r; \
+    return name(a); \
+  }
+
+#define HOST_FPU_FUSED_MULADD(S, name, fn) \
+  static inline S host_##name(S a, S b, S c) \
+  { \
+    S r; \
+    if (!host_fpu_is_nan(a) && !host_fpu_is_nan(b) && !host_fpu_is_nan(c) && \
+        host_fpu_run(&r, [=]() { \
+          host_fpu_t<S>::type x = host_fpu_from(a), y = host_fpu_from(b), \
+                              z = host_fpu_from(c); \
+          HOST_FPU_BARRIER(x); \
+          HOST_FPU_BARRIER(y); \
+          HOST_FPU_BARRIER(z); \
+          return fn(x, y, z); \
+        })) \
+      return r; \
+    return name(a, b, c); \
+  }
+
+#endif
+
+#ifndef HOST_FPU_BINARY
+#define HOST_FPU_BINARY(S, name, expr) \
+  static inline S host_##name(S a, S b) { return name(a, b); }
+#define HOST_FPU_SQRT(S, name, fn) \
+  static inline S host_##name(S a) { return name(a); }
+#endif
+
+#define HOST_FPU_SOFT_MULADD(S, name) \
+  static inline S host_##name(S a, S b, S c) { return name(a, b, c); }
+
+HOST_FPU_BINARY(float32_t, f32_add, x + y)
+HOST_FPU_BINARY(float32_t, f32_sub, x - y)
+HOST_FPU_BINARY(float32_t, f32_mul, x * y)
+HOST_FPU_BINARY(float32_t, f32_div, x / y)
+HOST_FPU_SQRT(float32_t, f32_sqrt, __builtin_sqrtf)
+#if defined(HOST_FPU) && defined(FP_FAST_FMAF)
+HOST_FPU_FUSED_MULADD(float32_t, f32_mulAdd, __builtin_fmaf)
+#else
+HOST_FPU_SOFT_MULADD(float32_t, f32_mulAdd)
+#endif
+
+HOST_FPU_BINARY(float64_t, f64_add, x + y)
+HOST_FPU_BINARY(float64_t, f64_sub, x - y)
+HOST_FPU_BINARY(float64_t, f64_mul, x * y)
+HOST_FPU_BINARY(float64_t, f64_div, x / y)
+HOST_FPU_SQRT(float64_t, f64_sqrt, __builtin_sqrt)
+#if defined(HOST_FPU) && defined(FP_FAST_FMA)
+HOST_FPU_FUSED_MULADD(float64_t, f64_mulAdd, __builtin_fma)
+#else
+HOST_FPU_SOFT_MULADD(float64_t, f64_mulAdd)
+#endif
+
+#endif
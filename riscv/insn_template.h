@@ -1,9 +1,12 @@
 // See LICENSE for license details.
 
 #include "arith.h"
+#include "detail.h"
 #include "mmu.h"
 #include "softfloat.h"
 #include "internals.h"
 #include "specialize.h"
 #include "tracer.h"
+#include "vector_kernels.h"
+#include "host_fpu.h"
 #include <assert.h>
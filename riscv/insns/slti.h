@@ -1 +1,6 @@
+if (unlikely(insn.rd() == 0 && insn.rs1() == 0) &&
+    (insn.i_imm() == DETAIL_MARKER_START || insn.i_imm() == DETAIL_MARKER_STOP)) {
+  p->region_marker(insn.i_imm());
+  serialize();
+}
 WRITE_RD(sreg_t(RS1) < sreg_t(insn.i_imm()));
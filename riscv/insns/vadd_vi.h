@@ -1,5 +1,5 @@
 // vadd.vi vd, simm5, vs2, vm
-VI_VI_LOOP
-({
+VI_VI_LOOP_HOST(vk_add, insn.v_simm5(),
+{
   vd = simm5 + vs2;
 })
@@ -1,5 +1,5 @@
 // vadd.vx vd, rs1, vs2, vm
-VI_VX_LOOP
-({
+VI_VX_LOOP_HOST(vk_add,
+{
   vd = rs1 + vs2;
 })
@@ -1,5 +1,5 @@
 // vand.vi vd, simm5, vs2, vm
-VI_VI_LOOP
-({
+VI_VI_LOOP_HOST(vk_and, insn.v_simm5(),
+{
   vd = simm5 & vs2;
 })
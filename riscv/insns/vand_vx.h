@@ -1,5 +1,5 @@
 // vand.vx vd, rs1, vs2, vm
-VI_VX_LOOP
-({
+VI_VX_LOOP_HOST(vk_and,
+{
   vd = rs1 & vs2;
 })
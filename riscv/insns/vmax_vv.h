@@ -1,6 +1,6 @@
 // vmax.vv vd, vs2, vs1, vm   # Vector-vector
-VI_VV_LOOP
-({
+VI_VV_LOOP_HOST(vk_max,
+{
   if (vs1 >= vs2) {
     vd = vs1;
   } else {
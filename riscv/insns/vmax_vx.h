@@ -1,6 +1,6 @@
 // vmax.vx vd, vs2, rs1, vm   # vector-scalar
-VI_VX_LOOP
-({
+VI_VX_LOOP_HOST(vk_max,
+{
   if (rs1 >= vs2) {
     vd = rs1;
   } else {
@@ -1,6 +1,6 @@
 // vmaxu.vv vd, vs2, vs1, vm   # Vector-vector
-VI_VV_ULOOP
-({
+VI_VV_ULOOP_HOST(vk_maxu,
+{
   if (vs1 >= vs2) {
     vd = vs1;
   } else {
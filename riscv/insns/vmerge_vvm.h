@@ -1,8 +1,8 @@
 // vmerge.vvm vd, vs2, vs1
 require_vector(true);
 VI_CHECK_SSS(true);
-VI_VVXI_MERGE_LOOP
-({
+VI_VVXI_MERGE_LOOP_HOST(true, 0,
+{
   int midx = i / 64;
   int mpos = i % 64;
   bool use_first = (P.VU.elt<uint64_t>(0, midx) >> mpos) & 0x1;
@@ -1,6 +1,6 @@
 // vminx.vx vd, vs2, rs1, vm   # vector-scalar
-VI_VX_LOOP
-({
+VI_VX_LOOP_HOST(vk_min,
+{
   if (rs1 <= vs2) {
     vd = rs1;
   } else {
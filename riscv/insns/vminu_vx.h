@@ -1,6 +1,6 @@
 // vminu.vx vd, vs2, rs1, vm   # vector-scalar
-VI_VX_ULOOP
-({
+VI_VX_ULOOP_HOST(vk_minu,
+{
   if (rs1 <= vs2) {
     vd = rs1;
   } else {
@@ -1,5 +1,5 @@
 // vseq.vi vd, vs2, simm5
-VI_VI_LOOP_CMP
-({
+VI_VI_LOOP_CMP_HOST(vk_eq,
+{
   res = simm5 == vs2;
 })
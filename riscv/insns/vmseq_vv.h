@@ -1,6 +1,6 @@
 // vseq.vv vd, vs2, vs1
-VI_VV_LOOP_CMP
-({
+VI_VV_LOOP_CMP_HOST(vk_eq,
+{
   res = vs2 == vs1;
 })
 
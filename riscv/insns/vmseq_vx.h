@@ -1,5 +1,5 @@
 // vseq.vx vd, vs2, rs1
-VI_VX_LOOP_CMP
-({
+VI_VX_LOOP_CMP_HOST(vk_eq,
+{
   res = rs1 == vs2;
 })
@@ -1,5 +1,5 @@
 // vsgt.vi  vd, vs2, simm5
-VI_VI_LOOP_CMP
-({
+VI_VI_LOOP_CMP_HOST(vk_gt,
+{
   res = vs2 > simm5;
 })
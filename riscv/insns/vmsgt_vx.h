@@ -1,5 +1,5 @@
 // vsgt.vx  vd, vs2, rs1
-VI_VX_LOOP_CMP
-({
+VI_VX_LOOP_CMP_HOST(vk_gt,
+{
   res = vs2 > rs1;
 })
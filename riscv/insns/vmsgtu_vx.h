@@ -1,5 +1,5 @@
 // vsgtu.vx  vd, vs2, rs1
-VI_VX_ULOOP_CMP
-({
+VI_VX_ULOOP_CMP_HOST(vk_gtu,
+{
   res = vs2 > rs1;
 })
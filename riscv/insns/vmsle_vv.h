@@ -1,5 +1,5 @@
 // vsle.vv vd, vs2, vs1
-VI_VV_LOOP_CMP
-({
+VI_VV_LOOP_CMP_HOST(vk_le,
+{
   res = vs2 <= vs1;
 })
@@ -1,5 +1,5 @@
 // vsleu.vv vd, vs2, vs1
-VI_VV_ULOOP_CMP
-({
+VI_VV_ULOOP_CMP_HOST(vk_leu,
+{
   res = vs2 <= vs1;
 })
@@ -1,5 +1,5 @@
 // vslt.vv  vd, vd2, vs1
-VI_VV_LOOP_CMP
-({
+VI_VV_LOOP_CMP_HOST(vk_lt,
+{
   res = vs2 < vs1;
 })
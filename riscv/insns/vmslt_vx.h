@@ -1,5 +1,5 @@
 // vslt.vx  vd, vs2, vs1
-VI_VX_LOOP_CMP
-({
+VI_VX_LOOP_CMP_HOST(vk_lt,
+{
   res = vs2 < rs1;
 })
@@ -1,5 +1,5 @@
 // vsltu.vx  vd, vs2, vs1
-VI_VX_ULOOP_CMP
-({
+VI_VX_ULOOP_CMP_HOST(vk_ltu,
+{
   res = vs2 < rs1;
 })
@@ -1,5 +1,5 @@
 // vsne.vi  vd, vs2, simm5
-VI_VI_LOOP_CMP
-({
+VI_VI_LOOP_CMP_HOST(vk_ne,
+{
   res = vs2 != simm5;
 })
@@ -1,5 +1,5 @@
 // vneq.vv  vd, vs2, vs1
-VI_VV_LOOP_CMP
-({
+VI_VV_LOOP_CMP_HOST(vk_ne,
+{
   res = vs2 != vs1;
 })
@@ -1,5 +1,5 @@
 // vsne.vx  vd, vs2, rs1
-VI_VX_LOOP_CMP
-({
+VI_VX_LOOP_CMP_HOST(vk_ne,
+{
   res = vs2 != rs1;
 })
@@ -1,5 +1,5 @@
 // vmul vd, vs2, vs1
-VI_VV_LOOP
-({
+VI_VV_LOOP_HOST(vk_mul,
+{
   vd = vs2 * vs1;
 })
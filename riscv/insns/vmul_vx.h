@@ -1,5 +1,5 @@
 // vmul vd, vs2, rs1
-VI_VX_LOOP
-({
+VI_VX_LOOP_HOST(vk_mul,
+{
   vd = vs2 * rs1;
 })
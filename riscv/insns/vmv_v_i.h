@@ -1,7 +1,7 @@
 // vmv.v.i vd, simm5
 require_vector(true);
 VI_CHECK_SSS(false);
-VI_VVXI_MERGE_LOOP
-({
+VI_VVXI_MERGE_LOOP_HOST(false, insn.v_simm5(),
+{
   vd = simm5;
 })
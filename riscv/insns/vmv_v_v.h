@@ -1,7 +1,7 @@
 // vvmv.v.v vd, vs1
 require_vector(true);
 VI_CHECK_SSS(true);
-VI_VVXI_MERGE_LOOP
-({
+VI_VVXI_MERGE_LOOP_HOST(true, 0,
+{
   vd = vs1;
 })
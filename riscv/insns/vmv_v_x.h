@@ -1,7 +1,7 @@
 // vmv.v.x vd, rs1
 require_vector(true);
 VI_CHECK_SSS(false);
-VI_VVXI_MERGE_LOOP
-({
+VI_VVXI_MERGE_LOOP_HOST(false, RS1,
+{
   vd = rs1;
 })
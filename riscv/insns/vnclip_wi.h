@@ -15,10 +15,10 @@ VI_VVXI_LOOP_NARROW
   // saturation
   if (result < int_min) {
     result = int_min;
-    P.VU.vxsat = 1;
+    set_vxsat(true);
   } else if (result > int_max) {
     result = int_max;
-    P.VU.vxsat = 1;
+    set_vxsat(true);
   }
 
   vd = result;
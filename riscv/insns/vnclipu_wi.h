@@ -16,7 +16,7 @@ VI_VVXI_LOOP_NARROW
   // saturation
   if (result & sign_mask) {
     result = uint_max;
-    P.VU.vxsat = 1;
+    set_vxsat(true);
   }
 
   vd = result;
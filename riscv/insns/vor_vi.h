@@ -1,5 +1,5 @@
 // vor
-VI_VI_LOOP
-({
+VI_VI_LOOP_HOST(vk_or, insn.v_simm5(),
+{
   vd = simm5 | vs2;
 })
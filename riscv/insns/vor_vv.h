@@ -1,5 +1,5 @@
 // vor
-VI_VV_LOOP
-({
+VI_VV_LOOP_HOST(vk_or,
+{
   vd = vs1 | vs2;
 })
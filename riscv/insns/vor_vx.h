@@ -1,5 +1,5 @@
 // vor
-VI_VX_LOOP
-({
+VI_VX_LOOP_HOST(vk_or,
+{
   vd = rs1 | vs2;
 })
@@ -24,6 +24,6 @@ default: {
   break;
 }
 }
-P.VU.vxsat |= sat;
+set_vxsat(sat);
 VI_LOOP_END
 
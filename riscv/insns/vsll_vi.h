@@ -1,5 +1,5 @@
 // vsll.vi  vd, vs2, zimm5
-VI_VI_LOOP
-({
+VI_VI_LOOP_HOST(vk_sll, insn.v_zimm5(),
+{
   vd = vs2 << (simm5 & (sew - 1) & 0x1f);
 })
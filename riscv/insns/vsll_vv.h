@@ -1,5 +1,5 @@
 // vsll
-VI_VV_LOOP
-({
+VI_VV_LOOP_HOST(vk_sll,
+{
   vd = vs2 << (vs1 & (sew - 1));
 })
@@ -1,5 +1,5 @@
 // vsll
-VI_VX_LOOP
-({
+VI_VX_LOOP_HOST(vk_sll,
+{
   vd = vs2 << (rs1 & (sew - 1));
 })
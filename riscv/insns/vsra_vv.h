@@ -1,5 +1,5 @@
 // vsra.vv  vd, vs2, vs1
-VI_VV_LOOP
-({
+VI_VV_LOOP_HOST(vk_sra,
+{
   vd = vs2 >> (vs1 & (sew - 1));
 })
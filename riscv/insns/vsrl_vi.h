@@ -1,5 +1,5 @@
 // vsrl.vi vd, vs2, zimm5
-VI_VI_ULOOP
-({
+VI_VI_ULOOP_HOST(vk_srl, insn.v_zimm5(),
+{
   vd = vs2 >> (zimm5 & (sew - 1) & 0x1f);
 })
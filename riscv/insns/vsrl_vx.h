@@ -1,5 +1,5 @@
 // vsrl.vx vd, vs2, rs1
-VI_VX_ULOOP
-({
+VI_VX_ULOOP_HOST(vk_srl,
+{
   vd = vs2 >> (rs1 & (sew - 1));
 })
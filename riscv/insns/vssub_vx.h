@@ -25,5 +25,5 @@ default: {
   break;
 }
 }
-P.VU.vxsat |= sat;
+set_vxsat(sat);
 VI_LOOP_END
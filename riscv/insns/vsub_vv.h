@@ -1,5 +1,5 @@
 // vsub
-VI_VV_LOOP
-({
+VI_VV_LOOP_HOST(vk_sub,
+{
   vd = vs2 - vs1;
 })
@@ -1,5 +1,5 @@
 // vxor
-VI_VI_LOOP
-({
+VI_VI_LOOP_HOST(vk_xor, insn.v_simm5(),
+{
   vd = simm5 ^ vs2;
 })
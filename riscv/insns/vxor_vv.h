@@ -1,5 +1,5 @@
 // vxor
-VI_VV_LOOP
-({
+VI_VV_LOOP_HOST(vk_xor,
+{
   vd = vs1 ^ vs2;
 })
@@ -1,5 +1,5 @@
 // vxor
-VI_VX_LOOP
-({
+VI_VX_LOOP_HOST(vk_xor,
+{
   vd = rs1 ^ vs2;
 })
@@ -0,0 +1,179 @@
+// See LICENSE for license details.
+
+#include "missprof.h"
+#include "mmu.h"
+#include <algorithm>
+#include <errno.h>
+#include <inttypes.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+
+miss_profile_t::~miss_profile_t()
+{
+  print_stats();
+  if (!csv_path.empty()) {
+    try {
+      write_csv(csv_path);
+    } catch (std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
+  }
+}
+
+void miss_profile_t::add_cache(cache_sim_t* cache)
+{
+  profiled_cache_t c;
+  c.name = cache->get_name();
+  c.line_shift = 0;
+  while ((size_t(1) << c.line_shift) < cache->get_linesz())
+    c.line_shift++;
+  cache->set_miss_profile(this, caches.size());
+  caches.push_back(c);
+}
+
+void miss_profile_t::set_symbols(const std::map<std::string, uint64_t>& symbols)
+{
+  this->symbols.clear();
+  for (auto& s : symbols)
+    if (!s.first.empty())
+      this->symbols[s.second] = s.first;
+}
+
+std::map<uint64_t, std::string>::const_iterator
+miss_profile_t::find_symbol(uint64_t addr) const
+{
+  auto it = symbols.upper_bound(addr);
+  if (it == symbols.begin())
+    return symbols.end();
+  return --it;
+}
+
+std::string miss_profile_t::describe(uint64_t addr) const
+{
+  auto it = find_symbol(addr);
+  if (it == symbols.end())
+    return "";
+
+  std::ostringstream s;
+  s << it->second;
+  if (addr != it->first)
+    s << "+0x" << std::hex << addr - it->first;
+  return s.str();
+}
+
+// rows of counts, most misses first, then lowest address first
+template <class T>
+static std::vector<std::pair<uint64_t, T>> sorted(const std::unordered_map<uint64_t, T>& counts)
+{
+  std::vector<std::pair<uint64_t, T>> v(counts.begin(), counts.end());
+  std::sort(v.begin(), v.end(), [](const std::pair<uint64_t, T>& a,
+                                   const std::pair<uint64_t, T>& b) {
+    if (a.second.total() != b.second.total())
+      return a.second.total() > b.second.total();
+    return a.first < b.first;
+  });
+  return v;
+}
+
+miss_profile_t::table_t miss_profile_t::pc_table(const profiled_cache_t& cache) const
+{
+  table_t table;
+  for (auto& c : sorted(cache.by_pc))
+    table.push_back(row_t{c.first, describe(c.first), c.second});
+  return table;
+}
+
+miss_profile_t::table_t miss_profile_t::region_table(const profiled_cache_t& cache) const
+{
+  // keyed by the symbol's address; lines below every symbol go under 0
+  std::unordered_map<uint64_t, counts_t> by_region;
+  for (auto& l : cache.by_line) {
+    auto it = find_symbol(l.first << cache.line_shift);
+    by_region[it == symbols.end() ? 0 : it->first].add(l.second);
+  }
+
+  table_t table;
+  for (auto& r : sorted(by_region)) {
+    auto it = symbols.find(r.first);
+    table.push_back(row_t{r.first, it == symbols.end() ? "" : it->second, r.second});
+  }
+  return table;
+}
+
+miss_profile_t::table_t miss_profile_t::page_table(const profiled_cache_t& cache) const
+{
+  std::unordered_map<uint64_t, counts_t> by_page;
+  for (auto& l : cache.by_line)
+    by_page[(l.first << cache.line_shift) & ~reg_t(PGSIZE - 1)].add(l.second);
+
+  table_t table;
+  for (auto& p : sorted(by_page))
+    table.push_back(row_t{p.first, describe(p.first), p.second});
+  return table;
+}
+
+void miss_profile_t::print_table(const std::string& title, const table_t& table)
+{
+  uint64_t total = 0;
+  for (auto& r : table)
+    total += r.counts.total();
+
+  std::ios::fmtflags flags = std::cout.flags();
+  std::streamsize precision = std::cout.precision();
+  std::cout << title << table.size() << " rows";
+  if (table.size() > rows)
+    std::cout << ", top " << rows;
+  std::cout << std::endl;
+  std::cout << "      Misses  Share        Reads      Writes  Address             Symbol"
+            << std::endl;
+  for (size_t i = 0; i < table.size() && i < rows; i++) {
+    const row_t& r = table[i];
+    std::cout << std::dec << std::setw(12) << r.counts.total() << "  "
+              << std::fixed << std::setprecision(1) << std::setw(5)
+              << 100.0 * r.counts.total() / total << "%"
+              << std::setw(12) << r.counts.reads
+              << std::setw(12) << r.counts.writes << "  0x"
+              << std::hex << std::setfill('0') << std::setw(16) << r.addr
+              << std::setfill(' ') << "  " << r.symbol << std::endl;
+  }
+  std::cout.flags(flags);
+  std::cout.precision(precision);
+}
+
+void miss_profile_t::print_stats()
+{
+  for (auto& c : caches) {
+    if (c.by_pc.empty())
+      continue;
+    print_table(c.name + " Misses by PC:       ", pc_table(c));
+    print_table(c.name + " Misses by Region:   ", region_table(c));
+    print_table(c.name + " Misses by Page:     ", page_table(c));
+  }
+}
+
+void miss_profile_t::write_table(FILE* out, const std::string& cache,
+                                 const char* kind, const table_t& table)
+{
+  for (auto& r : table)
+    fprintf(out, "%s,%s,0x%" PRIx64 ",%s,%" PRIu64 ",%" PRIu64 "\n",
+            cache.c_str(), kind, r.addr, r.symbol.c_str(),
+            r.counts.reads, r.counts.writes);
+}
+
+void miss_profile_t::write_csv(const std::string& path)
+{
+  FILE* out = fopen(path.c_str(), "w");
+  if (!out)
+    throw std::runtime_error("couldn't open " + path + ": " + strerror(errno));
+
+  fprintf(out, "cache,table,address,symbol,reads,writes\n");
+  for (auto& c : caches) {
+    write_table(out, c.name, "pc", pc_table(c));
+    write_table(out, c.name, "region", region_table(c));
+    write_table(out, c.name, "page", page_table(c));
+  }
+  fclose(out);
+}
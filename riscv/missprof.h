@@ -0,0 +1,120 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_MISSPROF_H
+#define _RISCV_MISSPROF_H
+
+#include "cachesim.h"
+#include "memtracer.h"
+#include "processor.h"
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Attributes each cache's misses to the pc of the instruction that caused
+// them, to the region the address missed on lies in, and to its page, so
+// that the code and data responsible for most misses can be found without
+// logging every miss.  A region is named after the nearest ELF symbol at or
+// below its address; symbols are those of the files spike loaded, so they
+// match physical addresses only where programs run untranslated, e.g. bare
+// metal or a kernel's direct map.  The tables list the rows with the most
+// misses, and a CSV file can hold all of them.
+class miss_profile_t
+{
+ public:
+  // rows is the length of each table printed
+  miss_profile_t(size_t rows, const std::string& csv_path)
+    : rows(rows), csv_path(csv_path), pc(0) {}
+  // prints the tables and writes the CSV file
+  ~miss_profile_t();
+
+  void add_cache(cache_sim_t* cache);
+  // the symbols to name pcs and regions after
+  void set_symbols(const std::map<std::string, uint64_t>& symbols);
+
+  // pc of the instruction now accessing memory
+  void set_current_pc(reg_t pc) { this->pc = pc; }
+  void miss(unsigned id, uint64_t addr, bool store)
+  {
+    counts_t& c = caches[id].by_pc[pc];
+    (store ? c.writes : c.reads)++;
+    counts_t& l = caches[id].by_line[addr >> caches[id].line_shift];
+    (store ? l.writes : l.reads)++;
+  }
+
+  void print_stats();
+  // throws std::runtime_error if path can't be written
+  void write_csv(const std::string& path);
+
+ private:
+  struct counts_t
+  {
+    counts_t() : reads(0), writes(0) {}
+    uint64_t total() const { return reads + writes; }
+    void add(const counts_t& c) { reads += c.reads; writes += c.writes; }
+
+    uint64_t reads;
+    uint64_t writes;
+  };
+  struct row_t
+  {
+    uint64_t addr;
+    std::string symbol;
+    counts_t counts;
+  };
+  typedef std::vector<row_t> table_t;
+
+  struct profiled_cache_t
+  {
+    std::string name;
+    unsigned line_shift;
+    std::unordered_map<reg_t, counts_t> by_pc;
+    std::unordered_map<uint64_t, counts_t> by_line;
+  };
+
+  // the nearest symbol at or below addr, or end() if there is none
+  std::map<uint64_t, std::string>::const_iterator find_symbol(uint64_t addr) const;
+  // symbol+offset, or empty if there is no symbol
+  std::string describe(uint64_t addr) const;
+  // the rows of each table, most misses first
+  table_t pc_table(const profiled_cache_t& cache) const;
+  table_t region_table(const profiled_cache_t& cache) const;
+  table_t page_table(const profiled_cache_t& cache) const;
+  void print_table(const std::string& title, const table_t& table);
+  void write_table(FILE* out, const std::string& cache, const char* kind,
+                   const table_t& table);
+
+  size_t rows;
+  std::string csv_path;
+  reg_t pc;
+  std::vector<profiled_cache_t> caches;
+  std::map<uint64_t, std::string> symbols;  // by address
+};
+
+// Tells profile the pc of proc's accesses, before passing them on to the
+// tracers in list.  Each hart registers its own.
+class miss_profile_tracer_t : public memtracer_t
+{
+ public:
+  miss_profile_tracer_t(miss_profile_t* profile, processor_t* proc)
+    : profile(profile), proc(proc) {}
+
+  bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
+  {
+    return list.interested_in_range(begin, end, type);
+  }
+  void trace(uint64_t addr, size_t bytes, access_type type)
+  {
+    profile->set_current_pc(proc->get_state()->pc);
+    list.trace(addr, bytes, type);
+  }
+
+  memtracer_list_t list;
+
+ private:
+  miss_profile_t* profile;
+  processor_t* proc;
+};
+
+#endif
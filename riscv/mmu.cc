@@ -8,7 +8,7 @@ reg_t physic_addr = 0;
 
 
 mmu_t::mmu_t(simif_t* sim, processor_t* proc)
- : sim(sim), proc(proc),
+ : sim(sim), proc(proc), decode_cache(NULL), fetch_watch(-1),
   check_triggers_fetch(false),
   check_triggers_load(false),
   check_triggers_store(false),
@@ -26,6 +26,36 @@ void mmu_t::flush_icache()
 {
   for (size_t i = 0; i < ICACHE_ENTRIES; i++)
     icache[i].tag = -1;
+  memset(icache_pages, 0, sizeof(icache_pages));
+}
+
+bool mmu_t::icache_may_hold(reg_t paddr, size_t len)
+{
+  if (len == 0)
+    return false;
+
+  reg_t first = paddr >> PGSHIFT, last = (paddr + len - 1) >> PGSHIFT;
+  for (reg_t page = first; page <= last && page - first < ICACHE_PAGE_BITS; page++) {
+    reg_t bit = page % ICACHE_PAGE_BITS;
+    if (icache_pages[bit / 64] & (uint64_t(1) << (bit % 64)))
+      return true;
+  }
+  return false;
+}
+
+reg_t mmu_t::fetch_watch_hit(processor_t* p, insn_t insn, reg_t pc)
+{
+  p->mmu->set_fetch_watch(-1);
+  p->sim->proc_fetch_watch(p->id);
+
+  // The callback may have switched tracers or logs on; stop here once the
+  // instruction has run, so that the execution loop picks them up.
+  reg_t npc = p->decode_insn(insn)(p, insn, pc);
+  if (!invalid_pc(npc)) {
+    p->state.pc = npc;
+    npc = PC_SERIALIZE_AFTER;
+  }
+  return npc;
 }
 
 void mmu_t::flush_tlb()
@@ -150,8 +180,7 @@ void mmu_t::load_slow_path(reg_t addr, reg_t len, uint8_t* bytes, uint32_t xlate
     memcpy(bytes, host_addr, len);
     if (tracer.interested_in_range(paddr, paddr + PGSIZE, LOAD))
       tracer.trace(paddr, len, LOAD);
-    else
-      refill_tlb(addr, paddr, host_addr, LOAD);
+    refill_tlb(addr, paddr, host_addr, LOAD);
   } else if (!mmio_load(paddr, len, bytes)) {
     throw trap_load_access_fault(addr, 0, 0);
   }
@@ -177,11 +206,11 @@ void mmu_t::store_slow_path(reg_t addr, reg_t len, const uint8_t* bytes, uint32_
   }
 
   if (auto host_addr = sim->addr_to_mem(paddr)) {
-    memcpy(host_addr, bytes, len);
+    // tracers see the store before it lands, so they can save the old data
     if (tracer.interested_in_range(paddr, paddr + PGSIZE, STORE))
       tracer.trace(paddr, len, STORE);
-    else
-      refill_tlb(addr, paddr, host_addr, STORE);
+    refill_tlb(addr, paddr, host_addr, STORE);
+    memcpy(host_addr, bytes, len);
   } else if (!mmio_store(paddr, len, bytes)) {
     throw trap_store_access_fault(addr, 0, 0);
   }
@@ -192,9 +221,9 @@ tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_
   reg_t idx = (vaddr >> PGSHIFT) % TLB_ENTRIES;
   reg_t expected_tag = vaddr >> PGSHIFT;
 
-  if ((tlb_load_tag[idx] & ~TLB_CHECK_TRIGGERS) != expected_tag)
+  if ((tlb_load_tag[idx] & ~(TLB_CHECK_TRIGGERS | TLB_TRACE)) != expected_tag)
     tlb_load_tag[idx] = -1;
-  if ((tlb_store_tag[idx] & ~TLB_CHECK_TRIGGERS) != expected_tag)
+  if ((tlb_store_tag[idx] & ~(TLB_CHECK_TRIGGERS | TLB_TRACE)) != expected_tag)
     tlb_store_tag[idx] = -1;
   if ((tlb_insn_tag[idx] & ~TLB_CHECK_TRIGGERS) != expected_tag)
     tlb_insn_tag[idx] = -1;
@@ -203,6 +232,11 @@ tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_
       (check_triggers_load && type == LOAD) ||
       (check_triggers_store && type == STORE))
     expected_tag |= TLB_CHECK_TRIGGERS;
+  // Tracers may lose interest in a page once they have seen an access to
+  // it, e.g. the dirty log, so ask them again.  Fetches are traced by the
+  // icache instead.
+  if (type != FETCH && tracer.interested_in_range(paddr, paddr + PGSIZE, type))
+    expected_tag |= TLB_TRACE;
 
   if (pmp_homogeneous(paddr & ~reg_t(PGSIZE - 1), PGSIZE)) {
     if (type == FETCH) tlb_insn_tag[idx] = expected_tag;
@@ -346,6 +380,8 @@ reg_t mmu_t::s2xlate(reg_t gva, reg_t gpa, access_type type, bool virt, bool mxr
       if ((pte & ad) != ad) {
         if (!pmp_ok(pte_paddr, vm.ptesize, STORE, PRV_S))
           throw_access_exception(gva, type);
+        if (tracer.interested_in_range(pte_paddr, pte_paddr + vm.ptesize, STORE))
+          tracer.trace(pte_paddr, vm.ptesize, STORE);
         *(uint32_t*)ppte |= to_le((uint32_t)ad);
       }
 #else
@@ -419,6 +455,8 @@ reg_t mmu_t::walk(reg_t addr, access_type type, reg_t mode, bool virt, bool mxr)
       if ((pte & ad) != ad) {
         if (!pmp_ok(pte_paddr, vm.ptesize, STORE, PRV_S))
           throw_access_exception(addr, type);
+        if (tracer.interested_in_range(pte_paddr, pte_paddr + vm.ptesize, STORE))
+          tracer.trace(pte_paddr, vm.ptesize, STORE);
         *(uint32_t*)ppte |= to_le((uint32_t)ad);
       }
 #else
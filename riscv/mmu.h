@@ -10,6 +10,7 @@
 #include "simif.h"
 #include "processor.h"
 #include "memtracer.h"
+#include "decode_cache.h"
 #include "byteorder.h"
 #include <stdlib.h>
 #include <vector>
@@ -117,6 +118,12 @@ public:
         if (proc) READ_MEM(addr, size); \
         return data; \
       } \
+      if (unlikely(tlb_load_tag[vpn % TLB_ENTRIES] == (vpn | TLB_TRACE))) { \
+        physic_addr = (tlb_data[vpn % TLB_ENTRIES].target_offset + addr); \
+        tracer.trace(physic_addr, size, LOAD); \
+        if (proc) READ_MEM(addr, size); \
+        return from_le(*(type##_t*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr)); \
+      } \
       type##_t res; \
       load_slow_path(addr, sizeof(type##_t), (uint8_t*)&res, (xlate_flags)); \
       if (proc) READ_MEM(addr, size); \
@@ -182,6 +189,12 @@ public:
         if (proc) WRITE_MEM(addr, val, size); \
         *(type##_t*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr) = to_le(val); \
       } \
+      else if (unlikely(tlb_store_tag[vpn % TLB_ENTRIES] == (vpn | TLB_TRACE))) { \
+        physic_addr = (tlb_data[vpn % TLB_ENTRIES].target_offset + addr); \
+        tracer.trace(physic_addr, size, STORE); \
+        if (proc) WRITE_MEM(addr, val, size); \
+        *(type##_t*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr) = to_le(val); \
+      } \
       else { \
         type##_t le_val = to_le(val); \
         store_slow_path(addr, sizeof(type##_t), (const uint8_t*)&le_val, (xlate_flags)); \
@@ -250,6 +263,16 @@ public:
     load_reservation_address = (reg_t)-1;
   }
 
+  // physical address reserved by the last LR, or -1 if none
+  reg_t get_load_reservation()
+  {
+    return load_reservation_address;
+  }
+  void set_load_reservation(reg_t paddr)
+  {
+    load_reservation_address = paddr;
+  }
+
   inline void acquire_load_reservation(reg_t vaddr)
   {
     reg_t paddr = translate(vaddr, 1, LOAD, 0);
@@ -265,13 +288,38 @@ public:
       throw trap_store_address_misaligned(vaddr, 0, 0);
 
     reg_t paddr = translate(vaddr, 1, STORE, 0);
-    if (auto host_addr = sim->addr_to_mem(paddr))
-      return load_reservation_address == refill_tlb(vaddr, paddr, host_addr, STORE).target_offset + vaddr;
-    else
+    if (auto host_addr = sim->addr_to_mem(paddr)) {
+      refill_tlb(vaddr, paddr, host_addr, STORE);
+      return load_reservation_address == paddr;
+    } else
       throw trap_store_access_fault(vaddr, 0, 0); // disallow SC to I/O space
   }
 
+  // Host address of [addr, addr + len) if the range lies within one page
+  // whose translation is already in the TLB for this access type and has no
+  // trigger or memtracer attached; NULL otherwise.  This lets the vector
+  // unit copy whole runs of elements at once.  No access is logged: the
+  // caller records what it touches.
+  inline char* bulk_host_addr(reg_t addr, reg_t len, access_type type)
+  {
+    reg_t vpn = addr >> PGSHIFT;
+    if (unlikely(len == 0 || ((addr + len - 1) >> PGSHIFT) != vpn))
+      return NULL;
+    reg_t tag = type == STORE ? tlb_store_tag[vpn % TLB_ENTRIES]
+                              : tlb_load_tag[vpn % TLB_ENTRIES];
+    if (unlikely(tag != vpn))
+      return NULL;
+    physic_addr = tlb_data[vpn % TLB_ENTRIES].target_offset + addr;
+    return tlb_data[vpn % TLB_ENTRIES].host_offset + addr;
+  }
+
   static const reg_t ICACHE_ENTRIES = 1024;
+  // An entry for an instruction on a page a memtracer wants fetches from
+  // keeps its decoded instruction, but has this bit, which no pc has, set
+  // in its tag.  It misses, and refill_icache() then just traces the fetch.
+  static const reg_t ICACHE_TRACED = 1;
+  // bits of the filter of physical pages the icache was filled from
+  static const size_t ICACHE_PAGE_BITS = 4096;
 
   inline size_t icache_index(reg_t addr)
   {
@@ -280,6 +328,12 @@ public:
 
   inline icache_entry_t* refill_icache(reg_t addr, icache_entry_t* entry)
   {
+    if (unlikely(entry->tag == (addr | ICACHE_TRACED)) && addr != reg_t(-2)) {
+      reg_t paddr = translate_insn_addr(addr).target_offset + addr;
+      tracer.trace(paddr, insn_length(entry->data.insn.bits()), FETCH);
+      return entry;
+    }
+
     auto tlb_entry = translate_insn_addr(addr);
     insn_bits_t insn = from_le(*(uint16_t*)(tlb_entry.host_offset + addr));
     int length = insn_length(insn);
@@ -298,16 +352,23 @@ public:
       insn |= (insn_bits_t)from_le(*(const uint16_t*)translate_insn_addr_to_host(addr + 2)) << 16;
     }
 
-    insn_fetch_t fetch = {proc->decode_insn(insn), insn};
+    reg_t paddr = tlb_entry.target_offset + addr;
+    note_icache_page(paddr);
+    if (unlikely(((addr + length - 1) ^ addr) >> PGSHIFT))
+      note_icache_page(translate_insn_addr(addr + length - 1).target_offset + addr + length - 1);
+    insn_fetch_t fetch = {decode_insn(paddr, insn), insn};
     entry->tag = addr;
     entry->next = &icache[icache_index(addr + length)];
     entry->data = fetch;
 
-    reg_t paddr = tlb_entry.target_offset + addr;;
     if (tracer.interested_in_range(paddr, paddr + 1, FETCH)) {
-      entry->tag = -1;
+      entry->tag = addr | ICACHE_TRACED;
       tracer.trace(paddr, length, FETCH);
     }
+    if (unlikely(addr == fetch_watch)) {
+      entry->tag = -1;
+      entry->data.func = &fetch_watch_hit;
+    }
     return entry;
   }
 
@@ -322,14 +383,33 @@ public:
   inline insn_fetch_t load_insn(reg_t addr)
   {
     icache_entry_t entry;
+    entry.tag = -1;
     return refill_icache(addr, &entry)->data;
   }
 
   void flush_tlb();
   void flush_icache();
+  // whether the icache may hold instructions read from physical memory in
+  // [paddr, paddr + len), so that writing there calls for flush_icache()
+  bool icache_may_hold(reg_t paddr, size_t len);
 
   void register_memtracer(memtracer_t*);
 
+  // Call sim->proc_fetch_watch() once this hart is about to execute the
+  // instruction at virtual address pc, then disarm.  -1 disarms it.
+  void set_fetch_watch(reg_t pc)
+  {
+    fetch_watch = pc;
+    flush_icache();
+  }
+
+  // back the icache with a (possibly shared) physically-indexed decode cache
+  void set_decode_cache(decode_cache_t* cache)
+  {
+    decode_cache = cache;
+    flush_icache();
+  }
+
   int is_dirty_enabled()
   {
 #ifdef RISCV_ENABLE_DIRTY
@@ -352,17 +432,47 @@ private:
   simif_t* sim;
   processor_t* proc;
   memtracer_list_t tracer;
+  decode_cache_t* decode_cache;
+  reg_t fetch_watch;
+  // stands in for the watched instruction, and executes it after the callback
+  static reg_t fetch_watch_hit(processor_t* p, insn_t insn, reg_t pc);
   reg_t load_reservation_address;
   uint16_t fetch_temp;
 
   // implement an instruction cache for simulator performance
   icache_entry_t icache[ICACHE_ENTRIES];
+  // a bit for each page the icache was filled from since it was flushed,
+  // by physical page number modulo ICACHE_PAGE_BITS
+  uint64_t icache_pages[ICACHE_PAGE_BITS / 64];
+
+  inline void note_icache_page(reg_t paddr)
+  {
+    reg_t bit = (paddr >> PGSHIFT) % ICACHE_PAGE_BITS;
+    icache_pages[bit / 64] |= uint64_t(1) << (bit % 64);
+  }
+
+  inline insn_func_t decode_insn(reg_t paddr, insn_t insn)
+  {
+    if (!decode_cache)
+      return proc->decode_insn(insn);
+
+    decode_cache_entry_t* e = decode_cache->lookup(paddr);
+    if (unlikely(e->paddr != paddr || e->bits != insn.bits())) {
+      insn_desc_t desc = proc->lookup_insn(insn);
+      *e = {paddr, insn.bits(), desc.rv32, desc.rv64};
+    }
+    return proc->get_xlen() == 64 ? e->rv64 : e->rv32;
+  }
 
   // implement a TLB for simulator performance
   static const reg_t TLB_ENTRIES = 256;
   // If a TLB tag has TLB_CHECK_TRIGGERS set, then the MMU must check for a
   // trigger match before completing an access.
   static const reg_t TLB_CHECK_TRIGGERS = reg_t(1) << 63;
+  // If a load or store TLB tag has TLB_TRACE set, then the access must be
+  // passed to the memtracers, which saves them the slow path on every
+  // access.  With both bits set, the slow path checks and traces.
+  static const reg_t TLB_TRACE = reg_t(1) << 62;
   tlb_entry_t tlb_data[TLB_ENTRIES];
   reg_t tlb_insn_tag[TLB_ENTRIES];
   reg_t tlb_load_tag[TLB_ENTRIES];
@@ -2,6 +2,8 @@
 
 #define ZERO	0
 #define T0      5
+#define T1      6
+#define T2      7
 #define S0      8
 #define S1      9
 
@@ -168,6 +170,37 @@ static uint32_t fld(unsigned int dest, unsigned int base, uint16_t offset)
     MATCH_FLD;
 }
 
+static uint32_t auipc(unsigned int dest, uint32_t imm) __attribute__ ((unused));
+static uint32_t auipc(unsigned int dest, uint32_t imm)
+{
+  return (bits(imm, 31, 12) << 12) |
+    (dest << 7) |
+    MATCH_AUIPC;
+}
+
+static uint32_t slli(unsigned int dest, unsigned int src, unsigned int shamt) __attribute__ ((unused));
+static uint32_t slli(unsigned int dest, unsigned int src, unsigned int shamt)
+{
+  return (bits(shamt, 5, 0) << 20) |
+    (src << 15) |
+    (dest << 7) |
+    MATCH_SLLI;
+}
+
+static uint32_t add(unsigned int dest, unsigned int src1, unsigned int src2) __attribute__ ((unused));
+static uint32_t add(unsigned int dest, unsigned int src1, unsigned int src2)
+{
+  return (src2 << 20) |
+    (src1 << 15) |
+    (dest << 7) |
+    MATCH_ADD;
+}
+
+static uint32_t mret(void) __attribute__ ((unused));
+static uint32_t mret(void) { return MATCH_MRET; }
+static uint32_t sfence_vma(void) __attribute__ ((unused));
+static uint32_t sfence_vma(void) { return MATCH_SFENCE_VMA; }
+
 static uint32_t ebreak(void) __attribute__ ((unused));
 static uint32_t ebreak(void) { return MATCH_EBREAK; }
 static uint32_t ebreak_c(void) __attribute__ ((unused));
@@ -21,7 +21,8 @@ static reg_t pc_hook;
 plic_t::plic_t(std::vector<processor_t*>& procs, size_t num_source, size_t num_context) :
   num_source(num_source), num_context(num_context), procs(procs), priority(num_source, 0), 
   ie(num_context, std::vector<plic_t::plic_reg_t>((num_source + 31) >> 5, 0)), ip((num_source + 31) >> 5),
-  threshold(num_context), claimed(num_context, std::vector<plic_t::plic_reg_t>((num_source + 31) >> 5))
+  threshold(num_context), claimed(num_context, std::vector<plic_t::plic_reg_t>((num_source + 31) >> 5)),
+  level((num_source + 31) >> 5)
   {
     pc_hook == 0x80002da8;
     for (size_t i = 0; i < procs.size(); i++) {
@@ -144,6 +145,7 @@ bool plic_t::store(reg_t addr, size_t len, const uint8_t* bytes) {
         if (*(plic_reg_t*)bytes < num_source) {
           uint32_t irq = *(plic_reg_t*)bytes;
           claimed[contextid][irq >> 5] &= ~(1 << (irq & 31));  // clear claimed
+          ip[irq >> 5] |= level[irq >> 5] & (1 << (irq & 31)); // still asserted
           plic_update();
         }
     }
@@ -201,16 +203,10 @@ void plic_t::plic_update() {
     bool ip = plic_int_check(i);
     switch (context[i].mode) {
       case 'M':
-        if (ip)
-          procs[context[i].hartid]->get_state()->mip |= MIP_MEIP;
-        else
-          procs[context[i].hartid]->get_state()->mip &= ~MIP_MEIP;
+        procs[context[i].hartid]->get_state()->set_mip(MIP_MEIP, ip);
         break;
       case 'S':
-        if (ip)
-          procs[context[i].hartid]->get_state()->mip |= MIP_SEIP;
-        else
-          procs[context[i].hartid]->get_state()->mip &= ~MIP_SEIP;
+        procs[context[i].hartid]->get_state()->set_mip(MIP_SEIP, ip);
         break;
       default: break;
     }
@@ -223,10 +219,15 @@ void plic_t::plic_irq (uint32_t irq, bool level) {
   if (this->procs[0]->get_state()->pc == pc_hook) {
     
   }
-  if (level)
+  // sources are level-triggered: one still asserted when its claim
+  // completes becomes pending again
+  if (level) {
+    this->level[irq >> 5] |= 1 << (irq & 31);
     ip[irq >> 5] |= 1 << (irq & 31);      // set pending
-  else
+  } else {
+    this->level[irq >> 5] &= ~(1 << (irq & 31));
     ip[irq >> 5] &= ~(1 << (irq & 31));   // clear pending
+  }
   plic_update();
 
   sim_prio = priority[1];
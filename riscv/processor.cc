@@ -25,7 +25,7 @@ processor_t::processor_t(const char* isa, const char* priv, const char* varch,
                          simif_t* sim, uint32_t id, bool halt_on_reset,
                          FILE* log_file)
   : debug(false), halt_request(HR_NONE), sim(sim), ext(NULL), id(id), xlen(0),
-  histogram_enabled(false), log_commits_enabled(false),
+  histogram_enabled(false), log_commits_enabled(false), bbv(NULL),
   log_file(log_file), halt_on_reset(halt_on_reset),
   extension_table(256, false), last_pc(1), executions(1)
 {
@@ -300,6 +300,8 @@ void state_t::reset(reg_t max_isa)
   pc = DEFAULT_RSTVEC;
   XPR.reset();
   FPR.reset();
+  csr_dirty.clear();
+  memset(csr_dirty_bits, 0, sizeof(csr_dirty_bits));
 
   prv = PRV_M;
   v = false;
@@ -378,6 +380,7 @@ void processor_t::vectorUnit_t::reset(){
   ELEN = get_elen();
   reg_file = malloc(NVPR * vlenb);
   memset(reg_file, 0, NVPR * vlenb);
+  reg_dirty = 0;
 
   vtype = 0;
   set_vl(0, 0, 0, -1); // default to illegal configuration
@@ -420,6 +423,8 @@ reg_t processor_t::vectorUnit_t::set_vl(int rd, int rs1, reg_t reqVL, reg_t newT
 
   vstart = 0;
   setvl_count++;
+  p->get_state()->mark_csr_dirty(CSR_VL);
+  p->get_state()->mark_csr_dirty(CSR_VTYPE);
   return vl;
 }
 
@@ -435,6 +440,12 @@ void processor_t::set_diffTest(bool value)
   diffTest = value;
 }
 
+void processor_t::raise_interrupt(reg_t which)
+{
+  trap_t t(((reg_t)1 << (max_xlen-1)) | which);
+  take_trap(t, state.pc);
+}
+
 
 void processor_t::set_histogram(bool value)
 {
@@ -453,8 +464,18 @@ void processor_t::enable_log_commits()
 {
   log_commits_enabled = true;
 }
+
+void processor_t::disable_log_commits()
+{
+  log_commits_enabled = false;
+}
 #endif
 
+void processor_t::region_marker(reg_t which)
+{
+  sim->proc_marker(id, which);
+}
+
 void processor_t::reset()
 {
   state.reset(max_isa);
@@ -698,6 +719,9 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
     state.vscause = (interrupt) ? (t.cause() - 1) : t.cause();
     state.vsepc = epc;
     state.vstval = t.get_tval();
+    state.mark_csr_dirty(CSR_VSCAUSE);
+    state.mark_csr_dirty(CSR_VSEPC);
+    state.mark_csr_dirty(CSR_VSTVAL);
 
     reg_t s = state.mstatus;
     s = set_field(s, MSTATUS_SPIE, get_field(s, MSTATUS_SIE));
@@ -715,6 +739,11 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
     state.stval = t.get_tval();
     state.htval = t.get_tval2();
     state.htinst = t.get_tinst();
+    state.mark_csr_dirty(CSR_SCAUSE);
+    state.mark_csr_dirty(CSR_SEPC);
+    state.mark_csr_dirty(CSR_STVAL);
+    state.mark_csr_dirty(CSR_HTVAL);
+    state.mark_csr_dirty(CSR_HTINST);
 
     reg_t s = state.mstatus;
     s = set_field(s, MSTATUS_SPIE, get_field(s, MSTATUS_SIE));
@@ -737,6 +766,11 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
     state.mtval = t.get_tval();
     state.mtval2 = t.get_tval2();
     state.mtinst = t.get_tinst();
+    state.mark_csr_dirty(CSR_MEPC);
+    state.mark_csr_dirty(CSR_MCAUSE);
+    state.mark_csr_dirty(CSR_MTVAL);
+    state.mark_csr_dirty(CSR_MTVAL2);
+    state.mark_csr_dirty(CSR_MTINST);
 
     reg_t s = state.mstatus;
     s = set_field(s, MSTATUS_MPIE, get_field(s, MSTATUS_MIE));
@@ -783,6 +817,7 @@ void processor_t::set_csr(int which, reg_t val)
 #endif
 
   val = zext_xlen(val);
+  state.mark_csr_dirty(which);
   reg_t supervisor_ints = supports_extension('S') ? MIP_SSIP | MIP_STIP | MIP_SEIP : 0;
   reg_t vssip_int = supports_extension('H') ? MIP_VSSIP : 0;
   reg_t hypervisor_ints = supports_extension('H') ? MIP_HS_MASK : 0;
@@ -829,19 +864,25 @@ void processor_t::set_csr(int which, reg_t val)
   {
     case CSR_FFLAGS:
       dirty_fp_state;
+      state.mark_csr_dirty(CSR_FCSR);
       state.fflags = val & (FSR_AEXC >> FSR_AEXC_SHIFT);
       break;
     case CSR_FRM:
       dirty_fp_state;
+      state.mark_csr_dirty(CSR_FCSR);
       state.frm = val & (FSR_RD >> FSR_RD_SHIFT);
       break;
     case CSR_FCSR:
       dirty_fp_state;
+      state.mark_csr_dirty(CSR_FFLAGS);
+      state.mark_csr_dirty(CSR_FRM);
       state.fflags = (val & FSR_AEXC) >> FSR_AEXC_SHIFT;
       state.frm = (val & FSR_RD) >> FSR_RD_SHIFT;
       break;
     case CSR_VCSR:
       dirty_vs_state;
+      state.mark_csr_dirty(CSR_VXSAT);
+      state.mark_csr_dirty(CSR_VXRM);
       VU.vxsat = (val & VCSR_VXSAT) >> VCSR_VXSAT_SHIFT;
       VU.vxrm = (val & VCSR_VXRM) >> VCSR_VXRM_SHIFT;
       break;
@@ -966,6 +1007,7 @@ void processor_t::set_csr(int which, reg_t val)
       } else {
         mask = state.mideleg & MIP_SSIP;
       }
+      state.mark_csr_dirty(CSR_MIP);
       state.mip = (state.mip & ~mask) | (val & mask);
       break;
     }
@@ -977,6 +1019,7 @@ void processor_t::set_csr(int which, reg_t val)
       } else {
         mask = state.mideleg & ~MIP_HS_MASK;
       }
+      state.mark_csr_dirty(CSR_MIE);
       state.mie = (state.mie & ~mask) | (val & mask);
       break;
     }
@@ -1239,10 +1282,12 @@ void processor_t::set_csr(int which, reg_t val)
       break;
     case CSR_VXSAT:
       dirty_vs_state;
+      state.mark_csr_dirty(CSR_VCSR);
       VU.vxsat = val & 0x1ul;
       break;
     case CSR_VXRM:
       dirty_vs_state;
+      state.mark_csr_dirty(CSR_VCSR);
       VU.vxrm = val & 0x3ul;
       break;
   }
@@ -1673,7 +1718,7 @@ reg_t illegal_instruction(processor_t* p, insn_t insn, reg_t pc)
   throw trap_illegal_instruction(0);
 }
 
-insn_func_t processor_t::decode_insn(insn_t insn)
+insn_desc_t processor_t::lookup_insn(insn_t insn)
 {
   // look up opcode in hash table
   size_t idx = insn.bits() % OPCODE_CACHE_SIZE;
@@ -1699,6 +1744,12 @@ insn_func_t processor_t::decode_insn(insn_t insn)
     opcode_cache[idx].match = insn.bits();
   }
 
+  return desc;
+}
+
+insn_func_t processor_t::decode_insn(insn_t insn)
+{
+  insn_desc_t desc = lookup_insn(insn);
   return xlen == 64 ? desc.rv64 : desc.rv32;
 }
 
@@ -1776,7 +1827,7 @@ bool processor_t::store(reg_t addr, size_t len, const uint8_t* bytes)
   {
     case 0:
       if (len <= 4) {
-        state.mip = set_field(state.mip, MIP_MSIP, bytes[0]);
+        state.set_mip(MIP_MSIP, bytes[0] & 1);
         return true;
       }
       break;
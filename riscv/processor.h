@@ -20,6 +20,7 @@ class simif_t;
 class trap_t;
 class extension_t;
 class disassembler_t;
+class bbv_t;
 
 struct insn_desc_t
 {
@@ -227,6 +228,37 @@ struct state_t
       STEP_STEPPED
   } single_step;
 
+  // CSRs written since the last clear_dirty(), each listed once; the
+  // integer and floating-point register files track their own writes
+  std::vector<uint16_t> csr_dirty;
+  uint64_t csr_dirty_bits[4096 / 64];
+  void mark_csr_dirty(int which)
+  {
+    uint64_t bit = (uint64_t)1 << (which % 64);
+    if (!(csr_dirty_bits[which / 64] & bit)) {
+      csr_dirty_bits[which / 64] |= bit;
+      csr_dirty.push_back(which);
+    }
+  }
+  // raise or lower the mip bits in mask from outside a CSR write, as the
+  // interrupt controllers do, marking mip written only if they change
+  void set_mip(reg_t mask, bool level)
+  {
+    reg_t val = level ? mip | mask : mip & ~mask;
+    if (val != mip) {
+      mark_csr_dirty(CSR_MIP);
+      mip = val;
+    }
+  }
+  void clear_dirty()
+  {
+    XPR.clear_dirty();
+    FPR.clear_dirty();
+    for (auto which : csr_dirty)
+      csr_dirty_bits[which / 64] = 0;
+    csr_dirty.clear();
+  }
+
 #ifdef RISCV_ENABLE_COMMITLOG
   commit_log_reg_t log_reg_write;
   commit_log_mem_t log_mem_read;
@@ -270,12 +302,18 @@ public:
   void set_debug(bool value);
   void set_diffTest(bool value);
   void set_histogram(bool value);
+  // Count basic block executions into bbv from now on, or stop if NULL.
+  void set_bbv(bbv_t* bbv) { this->bbv = bbv; }
+  // Report the region marker hint slti x0, x0, which to the simulator.
+  void region_marker(reg_t which);
 #ifdef RISCV_ENABLE_COMMITLOG
   void enable_log_commits();
+  void disable_log_commits();
   bool get_log_commits_enabled() const { return log_commits_enabled; }
 #endif
   void reset();
   void step(size_t n, bool check_int=true); // run for n cycles
+  void raise_interrupt(reg_t which); // take interrupt which, enabled or not
   void set_csr(int which, reg_t val);
   reg_t get_csr(int which);
   mmu_t* get_mmu() { return mmu; }
@@ -428,6 +466,7 @@ private:
   std::string isa_string;
   bool histogram_enabled;
   bool log_commits_enabled;
+  bbv_t* bbv;
   FILE *log_file;
   bool halt_on_reset;
   std::vector<bool> extension_table;
@@ -458,6 +497,7 @@ private:
   void parse_isa_string(const char*);
   void build_opcode_map();
   void register_base_instructions();
+  insn_desc_t lookup_insn(insn_t insn);
   insn_func_t decode_insn(insn_t insn);
 
   // Track repeated executions for processor_t::disasm()
@@ -471,6 +511,7 @@ public:
       processor_t* p;
       void *reg_file;
       char reg_referenced[NVPR];
+      uint32_t reg_dirty; // one bit per register written through elt() or elt_group()
       int setvl_count;
       reg_t vlmax;
       reg_t vstart, vxrm, vxsat, vl, vtype, vlenb;
@@ -495,6 +536,8 @@ public:
   	  n ^= elts_per_reg - 1;
 #endif
           reg_referenced[vReg] = 1;
+          if (is_write)
+            reg_dirty |= (uint32_t)1 << vReg;
 
 #ifdef RISCV_ENABLE_COMMITLOG
           if (is_write)
@@ -504,6 +547,30 @@ public:
           T *regStart = (T*)((char*)reg_file + vReg * (VLEN >> 3));
           return regStart[n];
         }
+
+      // Base of the register group starting at vReg, for loops that index
+      // elements directly instead of calling elt() for each one.  Does elt()'s
+      // bookkeeping once for the registers holding elements [start, end).
+      // Element order only matches elt() on little-endian hosts.
+      template<class T>
+        T* elt_group(reg_t vReg, reg_t start, reg_t end, bool is_write = false){
+          assert(vsew != 0);
+          assert((VLEN >> 3)/sizeof(T) > 0);
+          reg_t elts_per_reg = (VLEN >> 3) / (sizeof(T));
+          if (start < end) {
+            for (reg_t r = vReg + start / elts_per_reg;
+                 r <= vReg + (end - 1) / elts_per_reg; ++r) {
+              reg_referenced[r] = 1;
+              if (is_write)
+                reg_dirty |= (uint32_t)1 << r;
+#ifdef RISCV_ENABLE_COMMITLOG
+              if (is_write)
+                p->get_state()->log_reg_write[(r << 4) | 2] = {0, 0};
+#endif
+            }
+          }
+          return (T*)((char*)reg_file + vReg * (VLEN >> 3));
+        }
     public:
 
       void reset();
@@ -0,0 +1,58 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_RESERVATION_H
+#define _RISCV_RESERVATION_H
+
+#include "memtracer.h"
+#include "mmu.h"
+#include <vector>
+
+// Bytes covered by a load reservation, starting at its address rounded
+// down; a store overlapping them breaks it.
+#define RESERVATION_SET_SIZE 8
+
+// Breaks the other harts' load reservations when one hart stores to them.
+// Spike otherwise only drops a hart's reservation when the harts take
+// turns, which is enough for its own interleaving but not for one chosen
+// instruction by instruction by a DUT.  Each hart registers its own tracer,
+// so that a hart's stores leave its own reservation alone.  Stores to a
+// page only come here if the storing hart's TLB was flushed after another
+// hart reserved an address in it, so the owner's TLB must be flushed
+// whenever it resumes while another hart holds a reservation.
+class reservation_tracer_t : public memtracer_t
+{
+ public:
+  reservation_tracer_t(const std::vector<processor_t*>& procs, processor_t* owner)
+    : procs(procs), owner(owner) {}
+
+  bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
+  {
+    // begin is the address accessed, not the base of the page whose TLB
+    // entry this decides, so match on the page
+    if (type != STORE)
+      return false;
+    for (processor_t* p : procs) {
+      reg_t res = p->get_mmu()->get_load_reservation();
+      if (p != owner && res != reg_t(-1) && (res & PGMASK) == (begin & PGMASK))
+        return true;
+    }
+    return false;
+  }
+
+  void trace(uint64_t addr, size_t bytes, access_type type)
+  {
+    if (type != STORE)
+      return;
+    for (processor_t* p : procs) {
+      reg_t res = p->get_mmu()->get_load_reservation() & -reg_t(RESERVATION_SET_SIZE);
+      if (p != owner && addr < res + RESERVATION_SET_SIZE && addr + bytes > res)
+        p->get_mmu()->yield_load_reservation();
+    }
+  }
+
+ private:
+  const std::vector<processor_t*>& procs;
+  processor_t* owner;
+};
+
+#endif
@@ -0,0 +1,103 @@
+// See LICENSE for license details.
+
+#include "sampler.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+
+sampler_t::sampler_t(reg_t period, reg_t warmup, reg_t window)
+  : period(period), warmup(warmup), window(window), phase(FAST_FORWARD),
+    next(0), window_insns(0), windows(0)
+{
+  if (window == 0 || warmup > period || window > period - warmup)
+    throw std::invalid_argument("sampling needs 0 < window <= period - warmup");
+}
+
+sampler_t::~sampler_t()
+{
+  print_stats();
+}
+
+void sampler_t::add_cache(cache_sim_t* cache)
+{
+  sampled_cache_t c;
+  c.cache = cache;
+  c.accesses = 0;
+  c.misses = 0;
+  caches.push_back(c);
+}
+
+void sampler_t::start(reg_t instret)
+{
+  phase = FAST_FORWARD;
+  next = instret + period - warmup - window;
+}
+
+void sampler_t::advance(reg_t insns)
+{
+  switch (phase) {
+    case FAST_FORWARD:
+      phase = WARMUP;
+      next += warmup;
+      break;
+    case WARMUP:
+      phase = MEASURE;
+      next += window;
+      window_insns = insns;
+      for (auto& c : caches) {
+        c.accesses = c.cache->get_accesses();
+        c.misses = c.cache->get_misses();
+      }
+      break;
+    case MEASURE:
+      phase = FAST_FORWARD;
+      next += period - warmup - window;
+      windows++;
+      for (auto& c : caches) {
+        uint64_t accesses = c.cache->get_accesses() - c.accesses;
+        uint64_t misses = c.cache->get_misses() - c.misses;
+        // a window without accesses has no miss rate, but still counts
+        // toward the misses per instruction
+        if (accesses)
+          c.miss_rate.add(100.0 * misses / accesses);
+        if (insns > window_insns)
+          c.mpki.add(1000.0 * misses / (insns - window_insns));
+      }
+      break;
+  }
+}
+
+// Half the width of the 95% confidence interval of the mean, by the normal
+// approximation, which SMARTS relies on too given enough windows.
+double sampler_t::stat_t::half_width() const
+{
+  if (n < 2)
+    return 0;
+  double var = (sumsq - sum * sum / n) / (n - 1);
+  return 1.96 * std::sqrt(std::max(var, 0.0) / n);
+}
+
+void sampler_t::print_stats()
+{
+  if (windows == 0)
+    return;
+
+  std::cout << std::setprecision(3) << std::fixed;
+  std::cout << "Sampled Windows:       " << windows << " of " << window
+            << " instructions, after " << warmup << " of warm-up, every "
+            << period << std::endl;
+  for (auto& c : caches) {
+    if (c.miss_rate.n) {
+      std::cout << c.cache->get_name() << " ";
+      std::cout << "Sampled Miss Rate:     " << c.miss_rate.mean() << "% +- "
+                << c.miss_rate.half_width() << '%' << std::endl;
+    }
+    if (c.mpki.n) {
+      std::cout << c.cache->get_name() << " ";
+      std::cout << "Sampled MPKI:          " << c.mpki.mean() << " +- "
+                << c.mpki.half_width() << std::endl;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_SAMPLER_H
+#define _RISCV_SAMPLER_H
+
+#include "cachesim.h"
+#include "decode.h"
+#include <vector>
+
+// SMARTS-style sampled simulation.  Of every period instructions hart 0
+// retires, the last warmup + window are simulated in detail: the first
+// warmup of them only warm up the caches, and the last window are measured.
+// The rest are fast-forwarded.  Each cache's miss rate and misses per
+// thousand instructions are measured in every window, and reported as
+// their mean over the windows with a 95% confidence interval.
+class sampler_t
+{
+ public:
+  enum phase_t {
+    FAST_FORWARD,
+    WARMUP,
+    MEASURE,
+  };
+
+  // throws std::invalid_argument unless 0 < window <= period - warmup
+  sampler_t(reg_t period, reg_t warmup, reg_t window);
+  // prints the report
+  ~sampler_t();
+
+  void add_cache(cache_sim_t* cache);
+
+  // Start a period now, when hart 0 has retired instret instructions.
+  void start(reg_t instret);
+  phase_t get_phase() const { return phase; }
+  // hart 0's instret at which the next phase starts
+  reg_t get_next() const { return next; }
+  // Enter the next phase; insns is the instructions all harts have retired.
+  void advance(reg_t insns);
+
+  void print_stats();
+
+ private:
+  // mean and confidence interval of one quantity over the windows
+  struct stat_t
+  {
+    stat_t() : n(0), sum(0), sumsq(0) {}
+    void add(double x) { n++; sum += x; sumsq += x * x; }
+    double mean() const { return sum / n; }
+    double half_width() const;
+
+    size_t n;
+    double sum;
+    double sumsq;
+  };
+
+  struct sampled_cache_t
+  {
+    cache_sim_t* cache;
+    uint64_t accesses;  // at the start of the window
+    uint64_t misses;
+    stat_t miss_rate;
+    stat_t mpki;
+  };
+
+  reg_t period;
+  reg_t warmup;
+  reg_t window;
+  phase_t phase;
+  reg_t next;
+  reg_t window_insns;  // all harts' instret at the start of the window
+  size_t windows;
+  std::vector<sampled_cache_t> caches;
+};
+
+#endif
@@ -3,12 +3,15 @@
 #include "sim.h"
 #include "mmu.h"
 #include "dts.h"
+#include "extension.h"
 #include "remote_bitbang.h"
 #include "byteorder.h"
+#include <algorithm>
 #include <fstream>
 #include <map>
 #include <iostream>
 #include <sstream>
+#include <cinttypes>
 #include <climits>
 #include <cstdlib>
 #include <cassert>
@@ -48,11 +51,20 @@ sim_t::sim_t(const char* isa, const char* priv, const char* varch,
     dtb_file(dtb_file ? dtb_file : ""),
     dtb_enabled(dtb_enabled),
     log_file(log_path),
+    next_snapshot_id(0),
+    max_snapshots(8),
+    checkpoint_save_instret(0),
+    checkpoint_save_interval(0),
+    checkpoint_saves(0),
+    detail_next(NULL),
+    detailed(true),
+    sampler(NULL),
     current_step(0),
     current_proc(0),
     debug(false),
     histogram_enabled(false),
     log(false),
+    log_commits(false),
     remote_bitbang(NULL),
     diffTest(diffTest),
     debug_module(this, dm_config)
@@ -118,6 +130,8 @@ sim_t::sim_t(const char* isa, const char* priv, const char* varch,
 
 sim_t::~sim_t()
 {
+  // the harts' last basic block vectors are written here
+  bbvs.clear();
   for (size_t i = 0; i < procs.size(); i++)
     delete procs[i];
   delete debug_mmu;
@@ -130,9 +144,23 @@ void sim_thread_main(void* arg)
 
 void sim_t::main()
 {
-  if (!debug && log)
+  if (!debug && log && detailed)
     set_procs_debug(true);
 
+  if (!checkpoint_restore_path.empty()) {
+    try {
+      restore_checkpoint(checkpoint_restore_path);
+      if (!checkpoint_export_prefix.empty())
+        export_boot_image(checkpoint_export_prefix);
+    } catch (std::exception& e) {
+      fprintf(stderr, "%s\n", e.what());
+      exit(1);
+    }
+  }
+
+  if (sampler)
+    sampler->start(procs[0]->get_state()->minstret);
+
   while (!done())
   {
     if (debug || ctrlc_pressed)
@@ -158,6 +186,12 @@ void sim_t::step(size_t n, bool check_int)
   {
 
     steps = std::min(n - i, INTERLEAVE - current_step);
+    if (unlikely(!checkpoint_save_path.empty()))
+      maybe_save_checkpoint(steps);
+    if (unlikely(detail_next != NULL) && detail_next->kind == detail_trigger_t::INSTRET)
+      maybe_switch_detail(steps);
+    if (unlikely(sampler != NULL))
+      maybe_sample(steps);
     procs[current_proc]->step(steps, check_int);
 
 #ifdef ZJV_DEVICE_EXTENSTION 
@@ -179,6 +213,199 @@ void sim_t::step(size_t n, bool check_int)
   }
 }
 
+void sim_t::difftest_select(size_t hart)
+{
+  if (hart == current_proc)
+    return;
+  current_proc = hart;
+
+  // Refill this hart's TLB, so that its reservation_tracer_t is asked again
+  // about the pages the others reserved while it was not running.
+  for (processor_t* p : procs) {
+    if (p != procs[hart] && p->get_mmu()->get_load_reservation() != reg_t(-1)) {
+      procs[hart]->get_mmu()->flush_tlb();
+      break;
+    }
+  }
+}
+
+// Save each checkpoint asked for by set_checkpoint_save() once hart 0 has
+// reached it, and until then keep hart 0 from running past it.
+void sim_t::maybe_save_checkpoint(size_t& steps)
+{
+  if (current_proc != 0)
+    return;
+
+  reg_t instret = procs[0]->get_state()->minstret;
+  if (instret < checkpoint_save_instret) {
+    steps = std::min(steps, size_t(checkpoint_save_instret - instret));
+    return;
+  }
+
+  std::string path = checkpoint_save_path;
+  if (checkpoint_saves)
+    path += "." + std::to_string(checkpoint_saves);
+  try {
+    if (checkpoint_saves)
+      save_incremental_checkpoint(path);
+    else
+      save_checkpoint(path);
+    if (!checkpoint_export_prefix.empty())
+      export_boot_image(checkpoint_export_prefix);
+  } catch (std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    exit(1);
+  }
+  fprintf(stderr, "saved checkpoint %s at instret %" PRIu64 "\n",
+          path.c_str(), instret);
+
+  checkpoint_saves++;
+  if (checkpoint_save_interval) {
+    checkpoint_save_instret += checkpoint_save_interval;
+    steps = std::min(steps, size_t(checkpoint_save_interval));
+  } else {
+    checkpoint_save_path.clear();
+  }
+}
+
+void sim_t::set_detail_triggers(const detail_trigger_t& start,
+                                const detail_trigger_t& stop)
+{
+  detail_start = start;
+  detail_stop = stop;
+  set_detail(start.kind == detail_trigger_t::NONE);
+  arm_detail_trigger(detailed ? &detail_stop : &detail_start);
+}
+
+void sim_t::add_detail_tracer(size_t hart, memtracer_t* t)
+{
+  if (detail_tracers.empty()) {
+    for (processor_t* p : procs) {
+      detail_tracers.emplace_back(new detail_tracer_t);
+      detail_tracers.back()->enabled = detailed;
+      p->get_mmu()->register_memtracer(detail_tracers.back().get());
+    }
+  }
+  detail_tracers.at(hart)->list.hook(t);
+}
+
+void sim_t::set_detail(bool value)
+{
+  detailed = value;
+  for (auto& t : detail_tracers)
+    t->enabled = value;
+  if (log && !debug)
+    set_procs_debug(value);
+#ifdef RISCV_ENABLE_COMMITLOG
+  for (processor_t* p : procs) {
+    if (log_commits && value)
+      p->enable_log_commits();
+    else if (log_commits)
+      p->disable_log_commits();
+  }
+#endif
+
+  // the tracers' interest in each page is decided when it enters the TLB
+  for (processor_t* p : procs)
+    p->get_mmu()->flush_tlb();
+}
+
+void sim_t::arm_detail_trigger(const detail_trigger_t* t)
+{
+  detail_next = t && t->kind != detail_trigger_t::NONE ? t : NULL;
+  if (detail_next && detail_next->kind == detail_trigger_t::PC)
+    procs[0]->get_mmu()->set_fetch_watch(detail_next->value);
+}
+
+// Fire detail_next, which hart id has just reached, and wait for the stop
+// trigger next, if that was the start trigger.
+void sim_t::switch_detail(unsigned id)
+{
+  set_detail(!detailed);
+  fprintf(stderr, "detailed simulation %s on hart %u at pc 0x%" PRIx64 "\n",
+          detailed ? "started" : "stopped", id, procs[id]->get_state()->pc);
+  arm_detail_trigger(detail_next == &detail_start ? &detail_stop : NULL);
+}
+
+// Fire an instret trigger once hart 0 has reached it, and until then keep
+// hart 0 from running past it.
+void sim_t::maybe_switch_detail(size_t& steps)
+{
+  if (current_proc != 0)
+    return;
+
+  reg_t instret = procs[0]->get_state()->minstret;
+  while (detail_next && detail_next->kind == detail_trigger_t::INSTRET) {
+    if (instret < detail_next->value) {
+      steps = std::min(steps, size_t(detail_next->value - instret));
+      return;
+    }
+    switch_detail(0);
+  }
+}
+
+void sim_t::set_sampler(sampler_t* sampler)
+{
+  this->sampler = sampler;
+  set_detail(false);
+  arm_detail_trigger(NULL);
+}
+
+// Enter each phase of sampled simulation once hart 0 has reached it, and
+// until then keep hart 0 from running past it.
+void sim_t::maybe_sample(size_t& steps)
+{
+  if (current_proc != 0)
+    return;
+
+  reg_t instret = procs[0]->get_state()->minstret;
+  while (instret >= sampler->get_next()) {
+    reg_t insns = 0;
+    for (processor_t* p : procs)
+      insns += p->get_state()->minstret;
+    sampler->advance(insns);
+  }
+  steps = std::min(steps, size_t(sampler->get_next() - instret));
+
+  bool detail = sampler->get_phase() != sampler_t::FAST_FORWARD;
+  if (detail != detailed)
+    set_detail(detail);
+}
+
+bool sim_t::advance_cycles(size_t hart, reg_t n)
+{
+  if (n == 0)
+    return false;
+  if (hart != 0) {
+    get_core(hart)->get_state()->mcycle += n;
+    return false;
+  }
+
+  // sync_cycle() ticks the clint on the call that finds current_step at
+  // INSNS_PER_RTC_TICK, then every INSNS_PER_RTC_TICK calls after that
+  reg_t ticks = 0;
+  if (current_step > INSNS_PER_RTC_TICK || n <= INSNS_PER_RTC_TICK - current_step) {
+    current_step += n;
+  } else {
+    reg_t rest = n - (INSNS_PER_RTC_TICK - current_step) - 1;
+    ticks = 1 + rest / INSNS_PER_RTC_TICK;
+    current_step = 1 + rest % INSNS_PER_RTC_TICK;
+  }
+
+  bool fired = false;
+  if (ticks) {
+    std::vector<bool> pending(procs.size());
+    for (size_t i = 0; i < procs.size(); i++)
+      pending[i] = procs[i]->get_state()->mip & MIP_MTIP;
+    clint->increment(ticks);
+    for (size_t i = 0; i < procs.size(); i++)
+      fired |= !pending[i] && (procs[i]->get_state()->mip & MIP_MTIP);
+  }
+
+  get_core(hart)->get_state()->mcycle += n;
+  return fired;
+}
+
 void sim_t::set_debug(bool value)
 {
   debug = value;
@@ -192,9 +419,22 @@ void sim_t::set_histogram(bool value)
   }
 }
 
+void sim_t::set_bbv(const std::string& path, reg_t interval)
+{
+  for (processor_t* p : procs)
+    p->set_bbv(NULL);
+  bbvs.clear();
+  for (size_t i = 0; i < procs.size(); i++) {
+    std::string hart_path = procs.size() == 1 ? path : path + "." + std::to_string(i);
+    bbvs.emplace_back(new bbv_t(hart_path, interval));
+    procs[i]->set_bbv(bbvs.back().get());
+  }
+}
+
 void sim_t::configure_log(bool enable_log, bool enable_commitlog)
 {
   log = enable_log;
+  log_commits = enable_commitlog;
 
   if (!enable_commitlog)
     return;
@@ -224,6 +464,32 @@ void sim_t::set_procs_diffTest(bool value)
     procs[i]->set_diffTest(value);
 }
 
+void sim_t::set_shared_decode_cache(bool value)
+{
+  decode_cache.reset();
+
+  if (value) {
+    // harts may only share decoded instructions if they decode identically
+    for (size_t i = 1; i < procs.size(); i++) {
+      extension_t* a = procs[0]->get_extension();
+      extension_t* b = procs[i]->get_extension();
+      if (procs[i]->get_isa_string() != procs[0]->get_isa_string() ||
+          (a == NULL) != (b == NULL) || (a && strcmp(a->name(), b->name()) != 0)) {
+        fprintf(stderr, "warning: harts differ in ISA; "
+                        "not sharing the decode cache\n");
+        value = false;
+        break;
+      }
+    }
+  }
+
+  if (value)
+    decode_cache.reset(new decode_cache_t);
+
+  for (size_t i = 0; i < procs.size(); i++)
+    procs[i]->get_mmu()->set_decode_cache(decode_cache.get());
+}
+
 static bool paddr_ok(reg_t addr)
 {
   return (addr >> MAX_PADDR_BITS) == 0;
@@ -262,9 +528,16 @@ void sim_t::make_dtb()
   }
 }
 
+// instructions and data ahead of the DTB in the boot ROM
+static const int reset_vec_size = 8;
+
 void sim_t::set_rom()
 {
-  const int reset_vec_size = 8;
+  if (!boot_rom_image.empty()) {
+    boot_rom.reset(new rom_device_t(boot_rom_image));
+    bus.add_device(DEFAULT_RSTVEC, boot_rom.get());
+    return;
+  }
 
   start_pc = start_pc == reg_t(-1) ? get_entry_point() : start_pc;
 
@@ -285,23 +558,8 @@ void sim_t::set_rom()
 
   std::vector<char> rom((char*)reset_vec, (char*)reset_vec + sizeof(reset_vec));
 
-  std::string dtb;
-  if (!dtb_file.empty()) {
-    std::ifstream fin(dtb_file.c_str(), std::ios::binary);
-    if (!fin.good()) {
-      std::cerr << "can't find dtb file: " << dtb_file << std::endl;
-      exit(-1);
-    }
-
-    std::stringstream strstream;
-    strstream << fin.rdbuf();
-
-    dtb = strstream.str();
-  } else {
-    dts = make_dts(INSNS_PER_RTC_TICK, CPU_HZ, initrd_start, initrd_end, bootargs, procs, mems);
-    dtb = dts_compile(dts);
-  }
-
+  // the constructor already built the DTB, and nothing it depends on has
+  // changed since
   rom.insert(rom.end(), dtb.begin(), dtb.end());
   const int align = 0x1000;
   rom.resize((rom.size() + align - 1) / align * align);
@@ -320,14 +578,125 @@ char* sim_t::addr_to_mem(reg_t addr) {
   return NULL;
 }
 
+// Call f(host, offset, len) for each page of [paddr, paddr + len), provided
+// it is all memory.
+template<class F>
+static bool for_each_mem_page(simif_t* sim, reg_t paddr, size_t len, F f)
+{
+  for (size_t pos = 0; pos < len; ) {
+    size_t n = std::min(len - pos, size_t(PGSIZE - (paddr + pos) % PGSIZE));
+    if (!sim->addr_to_mem(paddr + pos))
+      return false;
+    pos += n;
+  }
+
+  for (size_t pos = 0; pos < len; ) {
+    size_t n = std::min(len - pos, size_t(PGSIZE - (paddr + pos) % PGSIZE));
+    f(sim->addr_to_mem(paddr + pos), pos, n);
+    pos += n;
+  }
+  return true;
+}
+
+bool sim_t::read_mem(reg_t paddr, void* dst, size_t len)
+{
+  return for_each_mem_page(this, paddr, len, [=](char* host, size_t pos, size_t n) {
+    memcpy((char*)dst + pos, host, n);
+  });
+}
+
+bool sim_t::write_mem(reg_t paddr, const void* src, size_t len)
+{
+  bool ok = for_each_mem_page(this, paddr, len, [=](char* host, size_t pos, size_t n) {
+    before_host_store(paddr + pos, n);
+    memcpy(host, (const char*)src + pos, n);
+  });
+  if (!ok)
+    return false;
+
+  // The TLBs map pages to the same host memory, so only the icaches, which
+  // hold decoded instructions under their virtual addresses, can be stale,
+  // and only if they were filled from a page written to.  The shared decode
+  // cache checks each entry's encoding when it is used.  Like a store by
+  // another hart, the write breaks reservations it overlaps.
+  for (processor_t* p : procs) {
+    mmu_t* mmu = p->get_mmu();
+    if (mmu->icache_may_hold(paddr, len))
+      mmu->flush_icache();
+    reg_t res = mmu->get_load_reservation() & -reg_t(RESERVATION_SET_SIZE);
+    if (paddr < res + RESERVATION_SET_SIZE && paddr + len > res)
+      mmu->yield_load_reservation();
+  }
+  return true;
+}
+
+void sim_t::start_dirty_log()
+{
+  if (!dirty_log) {
+    dirty_log.reset(new dirty_log_t);
+    for (processor_t* p : procs)
+      p->get_mmu()->register_memtracer(dirty_log.get());
+  }
+  dirty_log->clear();
+
+  // refill the TLBs, so that they trace stores to pages not yet logged
+  for (processor_t* p : procs)
+    p->get_mmu()->flush_tlb();
+}
+
+std::vector<reg_t> sim_t::take_dirty_pages(size_t max)
+{
+  if (!dirty_log)
+    return std::vector<reg_t>();
+
+  std::vector<reg_t> pages = dirty_log->take(max);
+  if (!pages.empty())
+    for (processor_t* p : procs)
+      p->get_mmu()->flush_tlb();
+  return pages;
+}
+
 // htif
 
 void sim_t::reset()
 {
-  if (dtb_enabled)
+  if (dtb_enabled || !boot_rom_image.empty())
     set_rom();
 }
 
+void sim_t::difftest_setup(bool boot_args)
+{
+  start();
+
+  // Leave each hart as the boot ROM would at start_pc, without running it:
+  // the ROM only loads a0, a1 and t0 and jumps, and the CSRs keep their
+  // reset values.
+  for (processor_t* p : procs) {
+    state_t* state = p->get_state();
+    state->XPR.reset();
+    state->pc = start_pc;
+    if (boot_args) {
+      state->XPR.write(10, p->get_csr(CSR_MHARTID));
+      state->XPR.write(11, DEFAULT_RSTVEC + reset_vec_size * sizeof(uint32_t));
+      state->XPR.write(5, start_pc);  // t0, which the ROM jumps through
+    }
+  }
+
+  if (procs.size() > 1 && reservation_tracers.empty()) {
+    for (processor_t* p : procs) {
+      reservation_tracers.emplace_back(new reservation_tracer_t(procs, p));
+      p->get_mmu()->register_memtracer(reservation_tracers.back().get());
+    }
+  }
+}
+
+std::map<std::string, uint64_t> sim_t::load_payload(const std::string& payload, reg_t* entry)
+{
+  std::map<std::string, uint64_t> loaded = htif_t::load_payload(payload, entry);
+  symbols.insert(loaded.begin(), loaded.end());
+  return loaded;
+}
+
 void sim_t::idle()
 {
   target.switch_to();
@@ -335,20 +704,43 @@ void sim_t::idle()
 
 void sim_t::read_chunk(addr_t taddr, size_t len, void* dst)
 {
-  assert(len == 8);
-  auto data = to_le(debug_mmu->load_uint64(taddr));
-  memcpy(dst, &data, sizeof data);
+  assert(len % 8 == 0);
+  if (read_mem(taddr, dst, len))
+    return;
+
+  for (size_t pos = 0; pos < len; pos += 8) {
+    auto data = to_le(debug_mmu->load_uint64(taddr + pos));
+    memcpy((char*)dst + pos, &data, sizeof data);
+  }
 }
 
 void sim_t::write_chunk(addr_t taddr, size_t len, const void* src)
 {
-  assert(len == 8);
-  uint64_t data;
-  memcpy(&data, src, sizeof data);
-  debug_mmu->store_uint64(taddr, from_le(data));
+  assert(len % 8 == 0);
+  if (write_mem(taddr, src, len))
+    return;
+
+  for (size_t pos = 0; pos < len; pos += 8) {
+    uint64_t data;
+    memcpy(&data, (const char*)src + pos, sizeof data);
+    debug_mmu->store_uint64(taddr + pos, from_le(data));
+  }
 }
 
 void sim_t::proc_reset(unsigned id)
 {
   debug_module.proc_reset(id);
 }
+
+void sim_t::proc_marker(unsigned id, reg_t which)
+{
+  if (detail_next && detail_next->kind == detail_trigger_t::MARKER &&
+      which == (detailed ? DETAIL_MARKER_STOP : DETAIL_MARKER_START))
+    switch_detail(id);
+}
+
+void sim_t::proc_fetch_watch(unsigned id)
+{
+  if (detail_next && detail_next->kind == detail_trigger_t::PC)
+    switch_detail(id);
+}
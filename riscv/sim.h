@@ -3,15 +3,24 @@
 #ifndef _RISCV_SIM_H
 #define _RISCV_SIM_H
 
+#include "bbv.h"
 #include "debug_module.h"
+#include "decode_cache.h"
+#include "detail.h"
 #include "devices.h"
+#include "dirty_log.h"
+#include "reservation.h"
+#include "sampler.h"
 #include "log_file.h"
 #include "processor.h"
 #include "simif.h"
+#include "snapshot.h"
 
 #include <fesvr/htif.h>
 #include <fesvr/context.h>
 #include <vector>
+#include <deque>
+#include <map>
 #include <string>
 #include <memory>
 #include <sys/types.h>
@@ -23,6 +32,7 @@
 
 class mmu_t;
 class remote_bitbang_t;
+class checkpoint_file_t;
 
 // this class encapsulates the processors and memory in a RISC-V machine.
 class sim_t : public htif_t, public simif_t
@@ -40,27 +50,39 @@ public:
   ~sim_t();
 
   // DiffTest
-  void difftest_continue(size_t n) { 
-    step(n, false); 
+  //
+  // Each hart is stepped on its own, in whatever order the DUT commits
+  // instructions; see difftest_select().
+  void difftest_continue(size_t hart, size_t n) {
+    difftest_select(hart);
+    step(n, false);
   }
 
-  void difftest_checkINT() {
+  void difftest_checkINT(size_t hart) {
+    difftest_select(hart);
     step(1, true);
   }
 
-  void sync_cycle() {
-    if (current_step == INSNS_PER_RTC_TICK) {
-        current_step = 0;
-        clint->increment(1);
+  // Count one DUT commit on hart: advance its mcycle and, for hart 0, the
+  // divider that ticks the clint.
+  void sync_cycle(size_t hart) {
+    if (hart == 0) {
+      if (current_step == INSNS_PER_RTC_TICK) {
+          current_step = 0;
+          clint->increment(1);
+      }
+      current_step++;
     }
-    // fprintf(stderr, "mtime %lx current_step %lx\n", clint.get()->get_mtime(), current_step);
-    current_step++; 
-    state_t* state = get_core(0)->get_state();
+    state_t* state = get_core(hart)->get_state();
     state->mcycle++;
   }  
 
-  void set_state (state_t* new_state) {
-    state_t* state = get_core(0)->get_state();
+  // Same as n calls to sync_cycle(hart), in one step.  Returns true if a
+  // machine timer interrupt became pending on some hart meanwhile.
+  bool advance_cycles(size_t hart, reg_t n);
+
+  void set_state (size_t hart, state_t* new_state) {
+    state_t* state = get_core(hart)->get_state();
     for (int i = 0; i < 32; i++) {
       state->XPR.write(i, new_state->XPR[i]);
     }
@@ -68,25 +90,97 @@ public:
     // TODO: else
   }
 
-  void set_state (int index, reg_t new_value) {
-    state_t* state = get_core(0)->get_state();
+  void set_state (size_t hart, int index, reg_t new_value) {
+    state_t* state = get_core(hart)->get_state();
     state->XPR.write(index, new_value);
   }
 
-  void difftest_setup() {
-    start();
-
-    state_t* state = get_core(0)->get_state();
-    do {
-      step(1, false);
-    } while(state->pc != start_pc);
+  // Load the program and put every hart at start_pc with its integer
+  // registers zeroed, or with a0 and a1 set up as by the boot ROM if
+  // boot_args.
+  void difftest_setup(bool boot_args = false);
 
-    state->XPR.reset();
+  state_t* get_state(size_t hart) {
+    return get_core(hart)->get_state();
   }
 
-  state_t* get_state() {
-    return get_core(0)->get_state();
+  // Copy-on-write snapshots of the harts, devices and memory (see
+  // snapshot.h).  snapshot() returns the new snapshot's id.  restore()
+  // rewinds to a snapshot and discards the ones taken after it; it returns
+  // false if that snapshot has already been discarded.  Only the newest
+  // max_snapshots are kept.
+  size_t snapshot();
+  bool restore(size_t id);
+  void set_max_snapshots(size_t n);
+  // Called before memory is written other than by a hart, e.g. by a
+  // testbench, so that the latest snapshot can save it first.
+  void before_host_store(reg_t paddr, size_t len);
+
+  // Copy to or from guest physical memory directly, a page at a time,
+  // rather than a word at a time through debug_mmu.  Writes discard the
+  // instructions the harts have decoded.  Both fail, copying nothing, unless
+  // the whole range is memory.
+  bool read_mem(reg_t paddr, void* dst, size_t len);
+  bool write_mem(reg_t paddr, const void* src, size_t len);
+  // Log the pages the harts store to from now on (see dirty_log.h), and
+  // take up to max of them from the log, lowest address first.
+  void start_dirty_log();
+  std::vector<reg_t> take_dirty_pages(size_t max);
+
+  // Save the whole simulation to a file, or restore it from one saved by
+  // the same build with the same configuration (see checkpoint.h).  Both
+  // throw std::runtime_error on failure.
+  void save_checkpoint(const std::string& path);
+  void restore_checkpoint(const std::string& path);
+  // Save an incremental checkpoint, of the pages stored to since the last
+  // checkpoint was saved, which must be in the same directory.
+  void save_incremental_checkpoint(const std::string& path);
+  // Have run() save a checkpoint once hart 0 has retired instret
+  // instructions, or restore one before it starts.  With an interval, it
+  // then saves an incremental one to path.1, path.2, ... every interval
+  // instructions.
+  void set_checkpoint_save(const std::string& path, reg_t instret,
+                           reg_t interval = 0) {
+    checkpoint_save_path = path;
+    checkpoint_save_instret = instret;
+    checkpoint_save_interval = interval;
   }
+  void set_checkpoint_restore(const std::string& path) {
+    checkpoint_restore_path = path;
+  }
+  // Write the state as a boot image for an RTL simulation that can't run
+  // to the same point itself: a restore ROM, to be loaded at the reset
+  // vector, at <prefix>-rom.bin, and each memory at <prefix>-<base>.bin,
+  // up to its last nonzero page.  The ROM sets each hart's registers, CSRs
+  // and CLINT timer and mrets to the saved pc and privilege mode; other
+  // devices, vector state and the few mstatus fields and mepc that mret
+  // itself writes are not restored.  RV64 harts with hart IDs 0 to n-1
+  // only.  Throws std::runtime_error on failure.
+  void export_boot_image(const std::string& prefix);
+  // Also export a boot image wherever a checkpoint is saved or restored.
+  void set_checkpoint_export(const std::string& prefix) {
+    checkpoint_export_prefix = prefix;
+  }
+  // Use image as the boot ROM, e.g. a restore ROM from export_boot_image(),
+  // instead of the reset vector and device tree.  Call before start().
+  void set_boot_rom(const std::vector<char>& image) { boot_rom_image = image; }
+
+  // Write each hart's basic block vectors, every interval instructions, to
+  // path, or to path.<hart> if there are several harts (see bbv.h).
+  // Throws std::runtime_error if a file can't be opened.
+  void set_bbv(const std::string& path, reg_t interval);
+
+  // Fast-forward until start fires, with the memtracers added by
+  // add_detail_tracer() detached and the instruction and commit logs off,
+  // then simulate in detail until stop, if it is set, fires (see detail.h).
+  // With only stop set, the run starts in detail.  Call after
+  // configure_log().
+  void set_detail_triggers(const detail_trigger_t& start, const detail_trigger_t& stop);
+  // Register t with hart, attached only during detailed simulation.
+  void add_detail_tracer(size_t hart, memtracer_t* t);
+  // Simulate in detail only in sampler's warm-up and measurement windows
+  // (see sampler.h), instead of by triggers.
+  void set_sampler(sampler_t* sampler);
 
   // run the simulation to completion
   int run();
@@ -103,15 +197,22 @@ public:
 
   void set_procs_debug(bool value);
   void set_procs_diffTest(bool value);
+  // Share one physically-indexed decode cache among all harts.  Must be
+  // called after any extensions have been registered.
+  void set_shared_decode_cache(bool value);
   void set_remote_bitbang(remote_bitbang_t* remote_bitbang) {
     this->remote_bitbang = remote_bitbang;
   }
   const char* get_dts() { if (dts.empty()) reset(); return dts.c_str(); }
   processor_t* get_core(size_t i) { return procs.at(i); }
+  // the symbols of the ELF files loaded so far, by name
+  const std::map<std::string, uint64_t>& get_symbols() const { return symbols; }
   unsigned nprocs() const { return procs.size(); }
 
   // Callback for processors to let the simulation know they were reset.
   void proc_reset(unsigned id);
+  void proc_marker(unsigned id, reg_t which);
+  void proc_fetch_watch(unsigned id);
 
 private:
   std::vector<std::pair<reg_t, mem_t*>> mems;
@@ -128,15 +229,53 @@ private:
   bool dtb_enabled;
   std::unique_ptr<rom_device_t> boot_rom;
   std::unique_ptr<clint_t> clint;
+  std::unique_ptr<decode_cache_t> decode_cache;
 #ifdef ZJV_DEVICE_EXTENSTION  
   std::unique_ptr<uart_t> uart;
   std::unique_ptr<plic_t> plic;
 #endif
   bus_t bus;
   log_file_t log_file;
+  std::deque<std::unique_ptr<sim_snapshot_t>> snapshots;
+  std::unique_ptr<snapshot_memtracer_t> snapshot_tracer;
+  size_t next_snapshot_id;
+  size_t max_snapshots;
+  std::unique_ptr<dirty_log_t> dirty_log;
+  std::vector<std::unique_ptr<reservation_tracer_t>> reservation_tracers;
+  std::string checkpoint_save_path;
+  reg_t checkpoint_save_instret;
+  reg_t checkpoint_save_interval;
+  size_t checkpoint_saves;
+  std::string checkpoint_parent;  // the last checkpoint saved
+  std::unique_ptr<dirty_log_t> checkpoint_dirty_log;  // pages stored to since
+  void start_checkpoint_dirty_log(const std::string& path);
+  std::string checkpoint_restore_path;
+  std::string checkpoint_export_prefix;
+  std::vector<char> boot_rom_image;
+  std::vector<std::unique_ptr<bbv_t>> bbvs;
+  // parent names the checkpoint this one follows, or is empty for a full
+  // one; it is read back when restoring.  An incremental checkpoint saves
+  // the pages at the addresses in dirty.
+  void checkpoint(checkpoint_file_t& f, std::string& parent,
+                  const std::vector<reg_t>& dirty);
+  void checkpoint_header(checkpoint_file_t& f, std::string& parent);
+  void maybe_save_checkpoint(size_t& steps);
+  detail_trigger_t detail_start;
+  detail_trigger_t detail_stop;
+  const detail_trigger_t* detail_next;  // the trigger to wait for, if any
+  bool detailed;
+  std::vector<std::unique_ptr<detail_tracer_t>> detail_tracers;  // per hart
+  void set_detail(bool value);
+  void arm_detail_trigger(const detail_trigger_t* t);
+  void switch_detail(unsigned id);
+  void maybe_switch_detail(size_t& steps);
+  sampler_t* sampler;
+  void maybe_sample(size_t& steps);
 
   processor_t* get_core(const std::string& i);
   void step(size_t n, bool check_int=true); // step through simulation
+  // make hart the one step() runs, in difftest mode
+  void difftest_select(size_t hart);
   static const size_t INTERLEAVE = 5000;
   static const size_t INSNS_PER_RTC_TICK = 100; // 10 MHz clock for 1 BIPS core
   static const size_t CPU_HZ = 1000000000; // 1GHz CPU
@@ -145,6 +284,7 @@ private:
   bool debug;
   bool histogram_enabled; // provide a histogram of PCs
   bool log;
+  bool log_commits;
   remote_bitbang_t* remote_bitbang;
   bool diffTest;
 
@@ -196,7 +336,9 @@ private:
   void read_chunk(addr_t taddr, size_t len, void* dst);
   void write_chunk(addr_t taddr, size_t len, const void* src);
   size_t chunk_align() { return 8; }
-  size_t chunk_max_size() { return 8; }
+  size_t chunk_max_size() { return PGSIZE; }
+  std::map<std::string, uint64_t> load_payload(const std::string& payload, reg_t* entry);
+  std::map<std::string, uint64_t> symbols;
 
 public:
   // Initialize this after procs, because in debug_module_t::reset() we
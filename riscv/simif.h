@@ -16,6 +16,10 @@ public:
   virtual bool mmio_store(reg_t addr, size_t len, const uint8_t* bytes) = 0;
   // Callback for processors to let the simulation know they were reset.
   virtual void proc_reset(unsigned id) = 0;
+  // Callbacks for processors to report a region marker hint, and to report
+  // reaching the pc set with mmu_t::set_fetch_watch().
+  virtual void proc_marker(unsigned id, reg_t which) = 0;
+  virtual void proc_fetch_watch(unsigned id) = 0;
 };
 
 #endif
@@ -0,0 +1,162 @@
+// See LICENSE for license details.
+
+#include "snapshot.h"
+#include "sim.h"
+#include "mmu.h"
+#include <algorithm>
+#include <string.h>
+
+static reg_t page_base(reg_t addr)
+{
+  return addr & ~reg_t(PGSIZE - 1);
+}
+
+bool snapshot_memtracer_t::interested_in_range(uint64_t begin, uint64_t end, access_type type)
+{
+  return current && type == STORE && !current->pages.count(page_base(begin));
+}
+
+void snapshot_memtracer_t::trace(uint64_t addr, size_t bytes, access_type type)
+{
+  // another tracer's interest also brings us stores to pages already saved
+  if (!interested_in_range(addr, addr + bytes, type))
+    return;
+
+  reg_t base = page_base(addr);
+  if (char* host = sim->addr_to_mem(base))
+    current->pages[base].assign(host, host + PGSIZE);
+}
+
+void save_hart(processor_t* p, sim_snapshot_t::hart_t& h)
+{
+  processor_t::vectorUnit_t& vu = p->VU;
+  h.state = *p->get_state();
+  h.vector = {vu.vlmax, vu.vstart, vu.vxrm, vu.vxsat, vu.vl, vu.vtype,
+              vu.vma, vu.vta, vu.vediv, vu.vsew, vu.vflmul, vu.vill,
+              vu.vstart_alu};
+  h.vregs.assign((char*)vu.reg_file, (char*)vu.reg_file + NVPR * vu.vlenb);
+  h.load_reservation = p->get_mmu()->get_load_reservation();
+}
+
+void restore_hart(processor_t* p, const sim_snapshot_t::hart_t& h)
+{
+  processor_t::vectorUnit_t& vu = p->VU;
+  const sim_snapshot_t::vector_t& v = h.vector;
+  *p->get_state() = h.state;
+  vu.vlmax = v.vlmax;
+  vu.vstart = v.vstart;
+  vu.vxrm = v.vxrm;
+  vu.vxsat = v.vxsat;
+  vu.vl = v.vl;
+  vu.vtype = v.vtype;
+  vu.vma = v.vma;
+  vu.vta = v.vta;
+  vu.vediv = v.vediv;
+  vu.vsew = v.vsew;
+  vu.vflmul = v.vflmul;
+  vu.vill = v.vill;
+  vu.vstart_alu = v.vstart_alu;
+  memcpy(vu.reg_file, h.vregs.data(), h.vregs.size());
+
+  // recompute the trigger state the MMU caches, flushing the TLB and the
+  // decoded instructions along with it
+  p->trigger_updated();
+  // so that an SC replayed after a rewind between it and its LR succeeds
+  p->get_mmu()->set_load_reservation(h.load_reservation);
+}
+
+size_t sim_t::snapshot()
+{
+  if (!snapshot_tracer) {
+    snapshot_tracer.reset(new snapshot_memtracer_t(this));
+    for (processor_t* p : procs)
+      p->get_mmu()->register_memtracer(snapshot_tracer.get());
+    debug_mmu->register_memtracer(snapshot_tracer.get());
+  }
+
+  std::unique_ptr<sim_snapshot_t> s(new sim_snapshot_t);
+  s->id = next_snapshot_id++;
+  s->harts.resize(procs.size());
+  for (size_t i = 0; i < procs.size(); i++)
+    save_hart(procs[i], s->harts[i]);
+  s->current_step = current_step;
+  s->current_proc = current_proc;
+  s->clint = clint->save();
+#ifdef ZJV_DEVICE_EXTENSTION
+  s->plic = plic->save();
+  s->uart = uart->save();
+#endif
+
+  // refill the TLBs, so that they trace stores to pages not yet saved
+  for (processor_t* p : procs)
+    p->get_mmu()->flush_tlb();
+  debug_mmu->flush_tlb();
+
+  snapshot_tracer->set_snapshot(s.get());
+  snapshots.push_back(std::move(s));
+  while (snapshots.size() > max_snapshots)
+    snapshots.pop_front();
+
+  return snapshots.back()->id;
+}
+
+bool sim_t::restore(size_t id)
+{
+  auto it = std::find_if(snapshots.begin(), snapshots.end(),
+    [=](const std::unique_ptr<sim_snapshot_t>& s) { return s->id == id; });
+  if (it == snapshots.end())
+    return false;
+
+  // newest first, so each page ends up as it was when this one was taken
+  for (auto s = snapshots.end(); s != it; ) {
+    --s;
+    for (auto& page : (*s)->pages) {
+      memcpy(addr_to_mem(page.first), page.second.data(), PGSIZE);
+      if (dirty_log)
+        dirty_log->trace(page.first, PGSIZE, STORE);
+    }
+  }
+
+  sim_snapshot_t* s = it->get();
+  for (size_t i = 0; i < procs.size(); i++)
+    restore_hart(procs[i], s->harts[i]);
+  current_step = s->current_step;
+  current_proc = s->current_proc;
+  clint->restore(s->clint);
+#ifdef ZJV_DEVICE_EXTENSTION
+  plic->restore(s->plic);
+  uart->restore(s->uart);
+#endif
+
+  // memory matches this snapshot again, and later ones are gone: it saves
+  // the pages stored to from now on, so the TLBs must trace them again
+  s->pages.clear();
+  snapshots.erase(it + 1, snapshots.end());
+  snapshot_tracer->set_snapshot(s);
+  for (processor_t* p : procs)
+    p->get_mmu()->flush_tlb();
+  debug_mmu->flush_tlb();
+  if (decode_cache)
+    decode_cache->flush();
+
+  return true;
+}
+
+void sim_t::set_max_snapshots(size_t n)
+{
+  max_snapshots = std::max(n, size_t(1));
+  while (snapshots.size() > max_snapshots)
+    snapshots.pop_front();
+}
+
+void sim_t::before_host_store(reg_t paddr, size_t len)
+{
+  if (!len)
+    return;
+  for (reg_t page = page_base(paddr); page < paddr + len; page += PGSIZE) {
+    if (snapshot_tracer)
+      snapshot_tracer->trace(page, 1, STORE);
+    if (checkpoint_dirty_log)
+      checkpoint_dirty_log->trace(page, PGSIZE, STORE);
+  }
+}
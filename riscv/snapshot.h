@@ -0,0 +1,74 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_SNAPSHOT_H
+#define _RISCV_SNAPSHOT_H
+
+// Copy-on-write snapshots of a sim_t, for rewinding a simulation a short
+// way, e.g. to replay the instructions before a difftest mismatch with
+// logging turned on.  Taking a snapshot copies the harts and the devices,
+// but no memory: instead, each page of memory is copied the first time it
+// is stored to afterwards, by a memtracer that is interested in stores to
+// pages not yet copied.  Restoring a snapshot writes back the pages saved
+// by it and by every later one.
+
+#include "processor.h"
+#include "devices.h"
+#include "memtracer.h"
+#include <unordered_map>
+#include <vector>
+
+class simif_t;
+
+struct sim_snapshot_t
+{
+  // vectorUnit_t state besides the register file, which lives in vregs
+  struct vector_t {
+    reg_t vlmax, vstart, vxrm, vxsat, vl, vtype, vma, vta, vediv, vsew;
+    float vflmul;
+    bool vill, vstart_alu;
+  };
+
+  struct hart_t {
+    state_t state;
+    vector_t vector;
+    std::vector<char> vregs;
+    reg_t load_reservation;  // physical address reserved by LR, or -1
+  };
+
+  size_t id;
+  std::vector<hart_t> harts;
+  size_t current_step;
+  size_t current_proc;
+  clint_t::snapshot_t clint;
+#ifdef ZJV_DEVICE_EXTENSTION
+  plic_t::snapshot_t plic;
+  uart_t::snapshot_t uart;
+#endif
+
+  // contents, when the snapshot was taken, of each page written since,
+  // keyed by physical address
+  std::unordered_map<reg_t, std::vector<char>> pages;
+};
+
+// Copy a hart's state to h, or back from it.  Restoring also discards what
+// the hart has cached about the old state.
+void save_hart(processor_t* p, sim_snapshot_t::hart_t& h);
+void restore_hart(processor_t* p, const sim_snapshot_t::hart_t& h);
+
+// Saves each page into the current snapshot before it is first stored to.
+class snapshot_memtracer_t : public memtracer_t
+{
+ public:
+  snapshot_memtracer_t(simif_t* sim) : sim(sim), current(NULL) {}
+
+  void set_snapshot(sim_snapshot_t* s) { current = s; }
+
+  bool interested_in_range(uint64_t begin, uint64_t end, access_type type);
+  void trace(uint64_t addr, size_t bytes, access_type type);
+
+ private:
+  simif_t* sim;
+  sim_snapshot_t* current;
+};
+
+#endif
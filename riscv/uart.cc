@@ -1,33 +1,99 @@
 #include "devices.h"
 #include "processor.h"
 #include <unistd.h>
-#include <sys/ioctl.h>
+#include <poll.h>
 
-uart_t::uart_t(plic_t* plic, bool diffTest, std::string file_path) : diffTest(diffTest), plic(plic) {
+// how long output without a newline may wait in tx_buf
+#define UART_TX_TIMEOUT std::chrono::milliseconds(10)
+// how often stdin is polled for input
+#define UART_RX_POLL_INTERVAL std::chrono::milliseconds(1)
+
+uart_t::uart_t(plic_t* plic, bool diffTest, std::string file_path) : diffTest(diffTest), plic(plic),
+    rx_head(0), rx_count(0), stdin_eof(false), irq_level(false) {
     file_fifo.open(file_path);
     if (file_fifo.is_open()) {
         printf("[SimUART] open uart file fifo %s\n", file_path.c_str());
     }
 }
 
+uart_t::~uart_t() {
+    flush_tx();
+}
+
 unsigned int sim_uart_irq;
 
 void uart_t::check_int() {
-    int amt;
-    if (file_fifo.is_open() && !file_fifo.eof()) {
-        plic->plic_irq(PLIC_UART_IRQ, true);
-        sim_uart_irq = true;
+    // steady_clock::now() needs no syscall, unlike poll()
+    if (!file_fifo.is_open() && !diffTest) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - rx_polled >= UART_RX_POLL_INTERVAL) {
+            rx_polled = now;
+            poll_stdin();
+        }
     }
-    else if (!diffTest && ((ioctl(0, FIONREAD, &amt) == 0) && (amt > 0)) ) {
-        plic->plic_irq(PLIC_UART_IRQ, true);
-        sim_uart_irq = false;
-    }
-    else {
-        plic->plic_irq(PLIC_UART_IRQ, false);
-        sim_uart_irq = false;
+    if (!tx_buf.empty() && std::chrono::steady_clock::now() - tx_since >= UART_TX_TIMEOUT)
+        flush_tx();
+
+    bool level = rx_ready();
+    sim_uart_irq = level && file_fifo.is_open();
+    if (level != irq_level) {
+        irq_level = level;
+        plic->plic_irq(PLIC_UART_IRQ, level);
     }
 }
 
+bool uart_t::rx_ready() {
+    if (file_fifo.is_open())
+        return !file_fifo.eof();
+    return rx_count != 0;
+}
+
+uint8_t uart_t::rx_get() {
+    uint8_t c = rx_buf[rx_head];
+    rx_head = (rx_head + 1) % rx_size;
+    rx_count--;
+    return c;
+}
+
+// Move whatever input is waiting on stdin into rx_buf, without blocking.
+void uart_t::poll_stdin() {
+    if (stdin_eof || rx_count == rx_size)
+        return;
+
+    struct pollfd pfd = {0, POLLIN, 0};
+    if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLIN | POLLHUP)))
+        return;
+
+    // up to the end of the ring; the rest is read next time
+    size_t tail = (rx_head + rx_count) % rx_size;
+    size_t len = rx_size - rx_count;
+    if (tail + len > rx_size)
+        len = rx_size - tail;
+    ssize_t got = read(0, rx_buf + tail, len);
+    if (got > 0)
+        rx_count += got;
+    else if (got == 0)
+        stdin_eof = true;
+}
+
+void uart_t::tx_put(uint8_t c) {
+    if (tx_buf.empty())
+        tx_since = std::chrono::steady_clock::now();
+    tx_buf.push_back(c);
+    if (c == '\n' || tx_buf.size() >= tx_size)
+        flush_tx();
+}
+
+void uart_t::flush_tx() {
+    if (tx_buf.empty())
+        return;
+    fputs("\x1b[34m", stdout);
+    fwrite(tx_buf.data(), 1, tx_buf.size(), stdout);
+    fputs("\x1b[0m", stdout);
+    fflush(stdout);
+    tx_buf.clear();
+}
+
 /* ns16550a Register offsets */
 #define UART_RHR   0x00  // Receiver Holding Register 
 #define UART_THR   0x00  // Transmitter Holding Register 
@@ -90,10 +156,8 @@ bool uart_t::load(reg_t addr, size_t len, uint8_t* bytes) {
                     }
                         
                 }
-                else if (!diffTest) {
-                    int amt;
-                    if ((ioctl(0, FIONREAD, &amt) == 0) && (amt > 0))
-                        read(0, bytes, len);
+                else if (rx_count) {
+                    *bytes = rx_get();
                 }
             }
             break; 
@@ -111,15 +175,9 @@ bool uart_t::load(reg_t addr, size_t len, uint8_t* bytes) {
             memcpy(&uart_mcr, bytes, len);
             break; 
         case UART_LSR : // 5 
-            int amt;
             *bytes = UART_LSR_TE | UART_LSR_THRE;
-            if (file_fifo.is_open()) {
-                *bytes |= !file_fifo.eof(); 
-            }
-            else if (!diffTest) {
-                if ((ioctl(0, FIONREAD, &amt) == 0) && (amt > 0))
-                    *bytes |= UART_LSR_DR; 
-            }
+            if (rx_ready())
+                *bytes |= UART_LSR_DR;
 
             break; 
         case UART_MSR : // 6  
@@ -144,9 +202,8 @@ bool uart_t::store(reg_t addr, size_t len, const uint8_t* bytes) {
     switch (addr) {
         case UART_THR : // 0
             if (uart_lcr & UART_LCR_DLAB) memcpy(&uart_dll, bytes, len);
-            else { 
-                fprintf(stdout, "\x1b[34m%c\x1b[0m", *bytes);
-                fflush(stdout); 
+            else {
+                tx_put(*bytes);
             }
             break; 
         case UART_IER : // 1
@@ -0,0 +1,211 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_VECTOR_KERNELS_H
+#define _RISCV_VECTOR_KERNELS_H
+
+// Host implementations of the common integer vector operations.  Each kernel
+// works on a whole register group at once, a host SIMD register's worth of
+// elements at a time, instead of going through vectorUnit_t::elt() for every
+// operand of every element.  The chunks are GCC vector types, which compile
+// to AVX2 or SSE2 on x86 hosts (whichever the compiler is allowed to use)
+// and to plain scalar code on hosts without a SIMD unit.
+//
+// Elements are handled as unsigned integers; operations that care about the
+// sign convert to the signed vector type of the same width.  Element order is
+// that of a little-endian host.  Only the first n elements are touched, and
+// if a mask is given, only those whose bit is set in it.
+
+#include "decode.h"
+#include <algorithm>
+#include <string.h>
+
+#ifdef __AVX2__
+# define VK_BYTES 32
+#else
+# define VK_BYTES 16
+#endif
+
+template<class T>
+struct vk_vec_t {
+  typedef T type __attribute__((vector_size(VK_BYTES), aligned(1), may_alias));
+  static const reg_t lanes = VK_BYTES / sizeof(T);
+};
+
+// signed vector type with the same lane width as V
+#define VK_SIGNED(V) decltype((V){} < (V){})
+#define VK_SHAMT(a, b) ((b) & (sizeof((a)[0]) * 8 - 1))
+
+// element-wise operations: f(vs2, vs1), f(vs2, rs1) or f(vs2, imm)
+struct vk_add  { template<class V> V operator()(V a, V b) const { return a + b; } };
+struct vk_sub  { template<class V> V operator()(V a, V b) const { return a - b; } };
+struct vk_rsub { template<class V> V operator()(V a, V b) const { return b - a; } };
+struct vk_and  { template<class V> V operator()(V a, V b) const { return a & b; } };
+struct vk_or   { template<class V> V operator()(V a, V b) const { return a | b; } };
+struct vk_xor  { template<class V> V operator()(V a, V b) const { return a ^ b; } };
+struct vk_mul  { template<class V> V operator()(V a, V b) const { return a * b; } };
+struct vk_sll  { template<class V> V operator()(V a, V b) const { return a << VK_SHAMT(a, b); } };
+struct vk_srl  { template<class V> V operator()(V a, V b) const { return a >> VK_SHAMT(a, b); } };
+struct vk_sra {
+  template<class V> V operator()(V a, V b) const {
+    typedef VK_SIGNED(V) S;
+    return (V)((S)a >> (S)VK_SHAMT(a, b));
+  }
+};
+struct vk_minu {
+  template<class V> V operator()(V a, V b) const { V m = (V)(a < b); return (a & m) | (b & ~m); }
+};
+struct vk_maxu {
+  template<class V> V operator()(V a, V b) const { V m = (V)(a > b); return (a & m) | (b & ~m); }
+};
+struct vk_min {
+  template<class V> V operator()(V a, V b) const {
+    typedef VK_SIGNED(V) S;
+    V m = (V)((S)a < (S)b);
+    return (a & m) | (b & ~m);
+  }
+};
+struct vk_max {
+  template<class V> V operator()(V a, V b) const {
+    typedef VK_SIGNED(V) S;
+    V m = (V)((S)a > (S)b);
+    return (a & m) | (b & ~m);
+  }
+};
+
+// comparisons: all-ones in each lane where vs2 <op> vs1/rs1/imm holds
+struct vk_eq  { template<class V> V operator()(V a, V b) const { return (V)(a == b); } };
+struct vk_ne  { template<class V> V operator()(V a, V b) const { return (V)(a != b); } };
+struct vk_ltu { template<class V> V operator()(V a, V b) const { return (V)(a < b); } };
+struct vk_leu { template<class V> V operator()(V a, V b) const { return (V)(a <= b); } };
+struct vk_gtu { template<class V> V operator()(V a, V b) const { return (V)(a > b); } };
+struct vk_lt {
+  template<class V> V operator()(V a, V b) const { typedef VK_SIGNED(V) S; return (V)((S)a < (S)b); }
+};
+struct vk_le {
+  template<class V> V operator()(V a, V b) const { typedef VK_SIGNED(V) S; return (V)((S)a <= (S)b); }
+};
+struct vk_gt {
+  template<class V> V operator()(V a, V b) const { typedef VK_SIGNED(V) S; return (V)((S)a > (S)b); }
+};
+
+static inline bool vk_mask_bit(const uint64_t* mask, reg_t i)
+{
+  return (mask[i / 64] >> (i % 64)) & 1;
+}
+
+// a mask with all of its first n bits set selects every element
+static inline const uint64_t* vk_simplify_mask(const uint64_t* mask, reg_t n)
+{
+  if (!mask)
+    return NULL;
+  for (reg_t w = 0; w < n / 64; w++)
+    if (mask[w] != UINT64_MAX)
+      return mask;
+  if (n % 64 && (~mask[n / 64] & ((UINT64_C(1) << (n % 64)) - 1)))
+    return mask;
+  return NULL;
+}
+
+// load the chunk of (up to) lanes elements at src; a short chunk is padded
+// with zeroes
+template<class T>
+static inline typename vk_vec_t<T>::type vk_load(const T* src, reg_t m)
+{
+  typedef typename vk_vec_t<T>::type V;
+  if (likely(m == vk_vec_t<T>::lanes))
+    return *(const V*)src;
+  V v = {};
+  memcpy(&v, src, m * sizeof(T));
+  return v;
+}
+
+template<class T>
+static inline typename vk_vec_t<T>::type vk_splat(T x)
+{
+  typename vk_vec_t<T>::type v;
+  for (reg_t j = 0; j < vk_vec_t<T>::lanes; j++)
+    v[j] = x;
+  return v;
+}
+
+// vd[i] = op(vs2[i], vs1 ? vs1[i] : x)
+template<class T, class OP>
+static inline void vk_binary(T* vd, const T* vs2, const T* vs1, T x,
+                             reg_t n, const uint64_t* mask, OP op)
+{
+  typedef typename vk_vec_t<T>::type V;
+  const reg_t lanes = vk_vec_t<T>::lanes;
+  const V vx = vk_splat(x);
+
+  mask = vk_simplify_mask(mask, n);
+  for (reg_t i = 0; i < n; i += lanes) {
+    reg_t m = std::min(lanes, n - i);
+    V r = op(vk_load(vs2 + i, m), vs1 ? vk_load(vs1 + i, m) : vx);
+    if (likely(m == lanes && !mask)) {
+      *(V*)(vd + i) = r;
+    } else {
+      for (reg_t j = 0; j < m; j++)
+        if (!mask || vk_mask_bit(mask, i + j))
+          vd[i + j] = r[j];
+    }
+  }
+}
+
+// bit i of vd = op(vs2[i], vs1 ? vs1[i] : x)
+template<class T, class OP>
+static inline void vk_compare(uint64_t* vd, const T* vs2, const T* vs1, T x,
+                              reg_t n, const uint64_t* mask, OP op)
+{
+  typedef typename vk_vec_t<T>::type V;
+  const reg_t lanes = vk_vec_t<T>::lanes;
+  const V vx = vk_splat(x);
+  uint64_t bits = 0;
+
+  for (reg_t i = 0; i < n; i += lanes) {
+    reg_t m = std::min(lanes, n - i);
+    V r = op(vk_load(vs2 + i, m), vs1 ? vk_load(vs1 + i, m) : vx);
+    for (reg_t j = 0; j < m; j++)
+      bits |= (uint64_t)(r[j] & 1) << ((i + j) % 64);
+
+    // lanes divides 64, so a chunk never straddles two mask words.  Each
+    // word is written only once all of the elements it covers have been
+    // read, in case vd overlaps vs2 or vs1.
+    reg_t end = i + m;
+    if (end % 64 == 0 || end == n) {
+      reg_t w = i / 64;
+      uint64_t active = end % 64 ? (UINT64_C(1) << (end % 64)) - 1 : UINT64_MAX;
+      if (mask)
+        active &= mask[w];
+      vd[w] = (vd[w] & ~active) | (bits & active);
+      bits = 0;
+    }
+  }
+}
+
+// vd[i] = !mask || mask bit i ? (vs1 ? vs1[i] : x) : vs2[i]
+template<class T>
+static inline void vk_merge(T* vd, const T* vs2, const T* vs1, T x,
+                            reg_t n, const uint64_t* mask)
+{
+  typedef typename vk_vec_t<T>::type V;
+  const reg_t lanes = vk_vec_t<T>::lanes;
+  const V vx = vk_splat(x);
+
+  mask = vk_simplify_mask(mask, n);
+  for (reg_t i = 0; i < n; i += lanes) {
+    reg_t m = std::min(lanes, n - i);
+    V r = vs1 ? vk_load(vs1 + i, m) : vx;
+    if (mask) {
+      V a = vk_load(vs2 + i, m);
+      for (reg_t j = 0; j < m; j++)
+        if (!vk_mask_bit(mask, i + j))
+          r[j] = a[j];
+    }
+    if (likely(m == lanes))
+      *(V*)(vd + i) = r;
+    else
+      memcpy(vd + i, &r, m * sizeof(T));
+  }
+}
+
+#endif
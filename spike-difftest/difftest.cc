@@ -0,0 +1,429 @@
+// See LICENSE for license details.
+
+#include "difftest.h"
+#include "sim.h"
+#include "mmu.h"
+#include "trap.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <deque>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+static std::unique_ptr<sim_t> sim;
+static std::unique_ptr<mem_t> mem;
+
+// instructions stepped since difftest_init()
+static uint64_t insn_count;
+// (instruction count, sim_t snapshot id) of each snapshot, oldest first
+static std::deque<std::pair<uint64_t, size_t>> snapshots;
+static uint64_t snapshot_interval;
+static size_t max_snapshots;
+
+// physical address of each hart's last load or store
+static std::vector<reg_t> last_paddr;
+
+// whether hart is one of the simulator's; the calls about a hart check this
+// first, so that a bad index fails rather than throwing out of the C API
+static bool valid(unsigned hart)
+{
+  return hart < sim->nprocs();
+}
+
+static processor_t* core(unsigned hart)
+{
+  return sim->get_core(hart);
+}
+
+static state_t* state(unsigned hart)
+{
+  return sim->get_state(hart);
+}
+
+// encoding of the hart's last instruction, without sign extension
+static uint64_t last_inst(unsigned hart)
+{
+  insn_t insn(state(hart)->last_inst);
+  int bits = insn.length() * 8;
+  return bits < 64 ? insn.bits() & ((reg_t(1) << bits) - 1) : insn.bits();
+}
+
+// forget the registers written so far
+static void clear_dirty(unsigned hart)
+{
+  state(hart)->clear_dirty();
+  core(hart)->VU.reg_dirty = 0;
+}
+
+static void clear_all_dirty()
+{
+  for (unsigned i = 0; i < sim->nprocs(); i++)
+    clear_dirty(i);
+}
+
+// run n instructions on hart, leaving snapshots alone
+static void run(unsigned hart, uint64_t n)
+{
+  physic_addr = last_paddr[hart];
+  sim->difftest_continue(hart, n);
+  last_paddr[hart] = physic_addr;
+}
+
+static std::vector<char> read_file(const char* path)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error(std::string("couldn't open ") + path);
+  return std::vector<char>(std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>());
+}
+
+static void take_snapshot()
+{
+  snapshots.push_back(std::make_pair(insn_count, sim->snapshot()));
+  while (snapshots.size() > max_snapshots)
+    snapshots.pop_front();
+}
+
+// take the periodic snapshot due before the next instruction, if any
+static void maybe_snapshot()
+{
+  if (snapshot_interval &&
+      (snapshots.empty() || insn_count - snapshots.back().first >= snapshot_interval))
+    take_snapshot();
+}
+
+int difftest_init(const difftest_config_t* config)
+{
+  difftest_fini();
+
+  debug_module_config_t dm_config = {
+    .progbufsize = 2,
+    .max_bus_master_bits = 0,
+    .require_authentication = false,
+    .abstract_rti = 0,
+    .support_hasel = true,
+    .support_abstract_csr_access = true,
+    .support_haltgroups = true,
+    .support_impebreak = true
+  };
+
+  const char* isa = config->isa ? config->isa : DEFAULT_ISA;
+  const char* priv = config->priv ? config->priv : DEFAULT_PRIV;
+  const char* varch = config->varch ? config->varch : DEFAULT_VARCH;
+  size_t nprocs = config->nprocs ? config->nprocs : 1;
+  reg_t mem_base = config->mem_base ? config->mem_base : DRAM_BASE;
+  size_t mem_size = config->mem_size ? config->mem_size : (size_t)2048 << 20;
+  reg_t start_pc = config->start_pc ? config->start_pc :
+                   config->boot_rom ? DEFAULT_RSTVEC : reg_t(-1);
+
+  // htif loads no program for "none"
+  std::vector<std::string> htif_args(1, config->elf ? config->elf : "none");
+
+  try {
+    mem.reset(new mem_t(mem_size));
+    std::vector<std::pair<reg_t, mem_t*>> mems(1, std::make_pair(mem_base, mem.get()));
+    sim.reset(new sim_t(isa, priv, varch, nprocs, false, false, 0, 0, NULL,
+                        start_pc, mems, {}, htif_args, std::vector<int>(),
+                        dm_config, NULL, true, NULL, true,
+                        config->uart_fifo ? config->uart_fifo : ""));
+    if (config->boot_rom)
+      sim->set_boot_rom(read_file(config->boot_rom));
+    sim->difftest_setup(config->boot_args);
+    snapshot_interval = config->snapshot_interval;
+    max_snapshots = config->max_snapshots ? config->max_snapshots : 8;
+    sim->set_max_snapshots(max_snapshots);
+    if (config->dirty_log)
+      sim->start_dirty_log();
+    last_paddr.assign(nprocs, 0);
+    clear_all_dirty();
+  } catch (std::exception& e) {
+    fprintf(stderr, "difftest: %s\n", e.what());
+    difftest_fini();
+    return DIFFTEST_ERROR;
+  }
+
+  return DIFFTEST_OK;
+}
+
+void difftest_fini(void)
+{
+  sim.reset();
+  mem.reset();
+  insn_count = 0;
+  snapshots.clear();
+  last_paddr.clear();
+}
+
+int difftest_step(unsigned hart, uint64_t n)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  clear_dirty(hart);
+  while (n) {
+    maybe_snapshot();
+    uint64_t k = n;
+    if (snapshot_interval)
+      k = std::min(k, snapshots.back().first + snapshot_interval - insn_count);
+    run(hart, k);
+    insn_count += k;
+    n -= k;
+  }
+  return DIFFTEST_OK;
+}
+
+int difftest_sync_cycle(unsigned hart)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  sim->sync_cycle(hart);
+  return DIFFTEST_OK;
+}
+
+int difftest_advance_cycles(unsigned hart, uint64_t n)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  return sim->advance_cycles(hart, n);
+}
+
+int difftest_raise_intr(unsigned hart, uint64_t cause)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  core(hart)->raise_interrupt(cause);
+  return DIFFTEST_OK;
+}
+
+uint64_t difftest_get_pc(unsigned hart)
+{
+  if (!valid(hart))
+    return 0;
+  return state(hart)->pc;
+}
+
+int difftest_set_pc(unsigned hart, uint64_t pc)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  state(hart)->pc = pc;
+  return DIFFTEST_OK;
+}
+
+int difftest_get_gprs(unsigned hart, uint64_t gpr[32])
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  for (int i = 0; i < NXPR; i++)
+    gpr[i] = state(hart)->XPR[i];
+  return DIFFTEST_OK;
+}
+
+int difftest_set_gprs(unsigned hart, const uint64_t gpr[32])
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  for (int i = 0; i < NXPR; i++)
+    state(hart)->XPR.write(i, gpr[i]);
+  return DIFFTEST_OK;
+}
+
+int difftest_get_fprs(unsigned hart, uint64_t fpr[32])
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  for (int i = 0; i < NFPR; i++)
+    fpr[i] = state(hart)->FPR[i].v[0];
+  return DIFFTEST_OK;
+}
+
+int difftest_set_fprs(unsigned hart, const uint64_t fpr[32])
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  for (int i = 0; i < NFPR; i++)
+    state(hart)->FPR.write(i, freg(f64(fpr[i])));
+  return DIFFTEST_OK;
+}
+
+int difftest_get_csrs(unsigned hart, const uint16_t* which, uint64_t* val, size_t n)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  try {
+    for (size_t i = 0; i < n; i++)
+      val[i] = core(hart)->get_csr(which[i]);
+  } catch (trap_t& t) {
+    return DIFFTEST_ERROR;
+  }
+  return DIFFTEST_OK;
+}
+
+int difftest_set_csrs(unsigned hart, const uint16_t* which, const uint64_t* val, size_t n)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  try {
+    for (size_t i = 0; i < n; i++)
+      core(hart)->set_csr(which[i], val[i]);
+  } catch (trap_t& t) {
+    return DIFFTEST_ERROR;
+  }
+  return DIFFTEST_OK;
+}
+
+int difftest_memcpy_to_guest(uint64_t paddr, const void* src, size_t n)
+{
+  return sim->write_mem(paddr, src, n) ? DIFFTEST_OK : DIFFTEST_ERROR;
+}
+
+int difftest_memcpy_from_guest(void* dst, uint64_t paddr, size_t n)
+{
+  return sim->read_mem(paddr, dst, n) ? DIFFTEST_OK : DIFFTEST_ERROR;
+}
+
+size_t difftest_get_dirty_pages(uint64_t* pages, size_t max)
+{
+  std::vector<reg_t> taken = sim->take_dirty_pages(max);
+  std::copy(taken.begin(), taken.end(), pages);
+  return taken.size();
+}
+
+int difftest_get_last(unsigned hart, difftest_last_t* last)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  last->pc = state(hart)->last_pc;
+  last->inst = last_inst(hart);
+  last->paddr = last_paddr[hart];
+  return DIFFTEST_OK;
+}
+
+int difftest_get_delta(unsigned hart, difftest_delta_t* delta)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  state_t* s = state(hart);
+  delta->pc = s->pc;
+
+  delta->gpr_mask = s->XPR.get_dirty();
+  for (uint64_t m = delta->gpr_mask; m; m &= m - 1) {
+    int i = __builtin_ctzll(m);
+    delta->gpr[i] = s->XPR[i];
+  }
+
+  delta->fpr_mask = s->FPR.get_dirty();
+  for (uint64_t m = delta->fpr_mask; m; m &= m - 1) {
+    int i = __builtin_ctzll(m);
+    delta->fpr[i] = s->FPR[i].v[0];
+  }
+
+  delta->vr_mask = core(hart)->VU.reg_dirty;
+
+  delta->ncsrs = 0;
+  delta->csr_overflow = 0;
+  for (auto which : s->csr_dirty) {
+    if (delta->ncsrs == DIFFTEST_DELTA_CSRS) {
+      delta->csr_overflow = 1;
+      break;
+    }
+    try {
+      delta->csr_val[delta->ncsrs] = core(hart)->get_csr(which);
+      delta->csr[delta->ncsrs++] = which;
+    } catch (trap_t& t) {
+      // not readable in the current state, e.g. fflags once FS is off
+    }
+  }
+  return DIFFTEST_OK;
+}
+
+int difftest_get_vreg(unsigned hart, unsigned reg, void* buf, size_t n)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  processor_t::vectorUnit_t& vu = core(hart)->VU;
+  if (reg >= NVPR || n > vu.vlenb)
+    return DIFFTEST_ERROR;
+  memcpy(buf, (char*)vu.reg_file + reg * vu.vlenb, n);
+  return DIFFTEST_OK;
+}
+
+uint64_t difftest_get_count(void)
+{
+  return insn_count;
+}
+
+int difftest_snapshot(void)
+{
+  take_snapshot();
+  return DIFFTEST_OK;
+}
+
+int difftest_rewind(uint64_t count, uint64_t* restored)
+{
+  while (!snapshots.empty() && snapshots.back().first > count)
+    snapshots.pop_back();
+  if (snapshots.empty() || !sim->restore(snapshots.back().second))
+    return DIFFTEST_ERROR;
+
+  insn_count = *restored = snapshots.back().first;
+  clear_all_dirty();
+  return DIFFTEST_OK;
+}
+
+void difftest_set_trace(int enable)
+{
+  sim->set_procs_debug(enable);
+}
+
+int difftest_check_commits(unsigned hart, const difftest_commit_t* commits,
+                           size_t n, difftest_mismatch_t* mismatch)
+{
+  if (!valid(hart))
+    return DIFFTEST_ERROR;
+  #define DIFFTEST_CHECK(f, r, d) \
+    if ((r) != (d)) { \
+      *mismatch = { i, f, r, d }; \
+      return DIFFTEST_MISMATCH; \
+    }
+
+  for (size_t i = 0; i < n; i++) {
+    const difftest_commit_t& c = commits[i];
+    if (c.flags & DIFFTEST_COMMIT_INTR) {
+      core(hart)->raise_interrupt(c.wdata);
+      continue;
+    }
+
+    state_t* s = state(hart);
+    reg_t pc = s->pc;
+
+    clear_dirty(hart);
+    maybe_snapshot();
+    run(hart, 1);
+    sim->sync_cycle(hart);
+    insn_count++;
+
+    DIFFTEST_CHECK(DIFFTEST_FIELD_PC, pc, c.pc);
+    DIFFTEST_CHECK(DIFFTEST_FIELD_INST, last_inst(hart), c.inst);
+    if (c.flags & DIFFTEST_COMMIT_MEM)
+      DIFFTEST_CHECK(DIFFTEST_FIELD_PADDR, last_paddr[hart], c.paddr);
+
+    if (c.flags & DIFFTEST_COMMIT_WEN) {
+      if (c.flags & DIFFTEST_COMMIT_SKIP)
+        s->XPR.write(c.rd, c.wdata);
+      DIFFTEST_CHECK(DIFFTEST_FIELD_WDATA, s->XPR[c.rd], c.wdata);
+    } else if (c.flags & DIFFTEST_COMMIT_FPWEN) {
+      if (c.flags & DIFFTEST_COMMIT_SKIP)
+        s->FPR.write(c.rd, freg(f64(c.wdata)));
+      DIFFTEST_CHECK(DIFFTEST_FIELD_WDATA, s->FPR[c.rd].v[0], c.wdata);
+    }
+  }
+
+  #undef DIFFTEST_CHECK
+  return DIFFTEST_OK;
+}
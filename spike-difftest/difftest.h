@@ -0,0 +1,244 @@
+// See LICENSE for license details.
+
+#ifndef _SPIKE_DIFFTEST_H
+#define _SPIKE_DIFFTEST_H
+
+// C interface to spike as the reference model of a difftest.  A testbench
+// links libspike-difftest.so in-process and drives a single simulator
+// instance through these calls; it needs no other spike header.
+//
+// Calls that can fail return DIFFTEST_OK or DIFFTEST_ERROR.  All calls but
+// difftest_init() require an initialized simulator.
+//
+// Calls about one hart take its index, from 0 to nprocs - 1, and return
+// DIFFTEST_ERROR for any other; difftest_get_pc() returns 0.  The harts run
+// only when stepped, one at a time, so a testbench for a multi-core DUT can
+// step each hart as the DUT commits its instructions.  Memory is shared,
+// and a store by one hart breaks the other harts' load reservations on the
+// doubleword it writes to, so LR/SC behaves as the DUT's interleaving
+// implies.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DIFFTEST_OK        0
+#define DIFFTEST_ERROR     (-1)
+#define DIFFTEST_MISMATCH  1
+
+// A zeroed field selects the default in its comment.
+typedef struct {
+  const char* isa;        // ISA string [configured default]
+  const char* priv;       // privilege modes [configured default]
+  const char* varch;      // vector uarch string [configured default]
+  size_t nprocs;          // number of harts [1]
+  uint64_t mem_base;      // guest memory base address [DRAM_BASE]
+  uint64_t mem_size;      // guest memory size in bytes [2 GiB]
+  const char* elf;        // program to load [none]
+  uint64_t start_pc;      // pc once the boot ROM has run [ELF entry point]
+  const char* uart_fifo;  // input FIFO for the ZJV UART [none]
+  uint64_t snapshot_interval;  // instructions between automatic snapshots [none]
+  size_t max_snapshots;   // snapshots kept, oldest dropped first [8]
+  int boot_args;          // start with a0 = hartid, a1 = DTB address and
+                          // t0 = start_pc, as the boot ROM leaves them
+                          // [zeroed]
+  int dirty_log;          // log the pages the harts store to [off]
+  const char* boot_rom;   // file to use as the boot ROM, e.g. a restore
+                          // ROM from spike --checkpoint-export; start_pc
+                          // then defaults to the reset vector [none]
+} difftest_config_t;
+
+typedef struct {
+  uint64_t pc;            // pc of the last instruction executed
+  uint64_t inst;          // its encoding
+  uint64_t paddr;         // physical address of the last load or store
+} difftest_last_t;
+
+// registers written by the hart's last difftest_step() or
+// difftest_check_commits() record; only the entries selected by the masks
+// are filled in
+#define DIFFTEST_DELTA_CSRS  16
+
+typedef struct {
+  uint64_t pc;            // pc of the next instruction
+  uint32_t gpr_mask;      // bit i set if x[i] was written
+  uint32_t fpr_mask;      // bit i set if f[i] was written
+  uint32_t vr_mask;       // bit i set if v[i] was written; see difftest_get_vreg()
+  uint32_t ncsrs;         // entries in csr[] and csr_val[]
+  int csr_overflow;       // more CSRs were written than csr[] holds
+  uint64_t gpr[32];
+  uint64_t fpr[32];       // low 64 bits, as for difftest_get_fprs()
+  uint16_t csr[DIFFTEST_DELTA_CSRS];
+  uint64_t csr_val[DIFFTEST_DELTA_CSRS];
+} difftest_delta_t;
+
+// difftest_commit_t flags
+#define DIFFTEST_COMMIT_WEN    0x1  // wrote integer register rd
+#define DIFFTEST_COMMIT_FPWEN  0x2  // wrote floating-point register rd
+#define DIFFTEST_COMMIT_MEM    0x4  // accessed memory at paddr
+#define DIFFTEST_COMMIT_SKIP   0x8  // copy wdata into rd instead of comparing,
+                                    // e.g. for an MMIO load
+#define DIFFTEST_COMMIT_INTR   0x10 // no instruction: take interrupt number
+                                    // wdata, as difftest_raise_intr() does
+
+// one instruction committed by the DUT
+typedef struct {
+  uint64_t pc;
+  uint64_t inst;
+  uint64_t wdata;
+  uint64_t paddr;
+  uint8_t rd;
+  uint8_t flags;
+} difftest_commit_t;
+
+// difftest_mismatch_t fields
+#define DIFFTEST_FIELD_PC     0
+#define DIFFTEST_FIELD_INST   1
+#define DIFFTEST_FIELD_WDATA  2
+#define DIFFTEST_FIELD_PADDR  3
+
+typedef struct {
+  size_t index;           // first commit record that differs
+  int field;              // DIFFTEST_FIELD_*
+  uint64_t ref;           // spike's value
+  uint64_t dut;           // the record's value
+} difftest_mismatch_t;
+
+// Build the simulator, load the program and put the harts at start_pc
+// with their CSRs at reset values and their integer registers zeroed,
+// without running the boot ROM.
+int difftest_init(const difftest_config_t* config);
+void difftest_fini(void);
+
+// Execute n instructions on hart without taking interrupts.
+int difftest_step(unsigned hart, uint64_t n);
+// Advance the hart's mcycle by one DUT commit; commits on hart 0 also
+// drive the CLINT timer.
+int difftest_sync_cycle(unsigned hart);
+// Advance them by n commits at once, as n calls to difftest_sync_cycle()
+// would.  Returns 1 if a machine timer interrupt became pending meanwhile,
+// 0 if not.
+int difftest_advance_cycles(unsigned hart, uint64_t n);
+// Take interrupt number cause now, whether or not it is pending and enabled.
+int difftest_raise_intr(unsigned hart, uint64_t cause);
+
+uint64_t difftest_get_pc(unsigned hart);
+int difftest_set_pc(unsigned hart, uint64_t pc);
+int difftest_get_gprs(unsigned hart, uint64_t gpr[32]);
+int difftest_set_gprs(unsigned hart, const uint64_t gpr[32]);
+// Floating-point registers are exchanged as their low 64 bits.
+int difftest_get_fprs(unsigned hart, uint64_t fpr[32]);
+int difftest_set_fprs(unsigned hart, const uint64_t fpr[32]);
+// Read or write the n CSRs numbered which[0..n-1].
+int difftest_get_csrs(unsigned hart, const uint16_t* which, uint64_t* val, size_t n);
+int difftest_set_csrs(unsigned hart, const uint16_t* which, const uint64_t* val, size_t n);
+
+// Copy to or from guest physical memory; MMIO ranges are not accessible,
+// and a range that includes any is not copied at all.  Copies go straight
+// to spike's memory a page at a time, so a testbench can mirror the writes
+// of agents spike does not model, e.g. DMA engines, at memcpy speed.
+int difftest_memcpy_to_guest(uint64_t paddr, const void* src, size_t n);
+int difftest_memcpy_from_guest(void* dst, uint64_t paddr, size_t n);
+// With dirty_log configured, store the physical addresses of up to max of
+// the pages the harts have stored to since difftest_init() or since the
+// page was last returned, lowest first, and return how many were stored.
+// Pages not returned are kept for the next call.  Copying each page with
+// difftest_memcpy_from_guest() brings another model of memory up to date.
+size_t difftest_get_dirty_pages(uint64_t* pages, size_t max);
+
+int difftest_get_last(unsigned hart, difftest_last_t* last);
+
+// Describe what the last step changed, in time proportional to the number
+// of registers written rather than the size of the register state.  CSRs
+// that count every instruction or cycle are not reported; mip is, when the
+// CLINT or PLIC has changed it since the step began.
+int difftest_get_delta(unsigned hart, difftest_delta_t* delta);
+// Copy the first n bytes of vector register reg, n <= VLEN/8.
+int difftest_get_vreg(unsigned hart, unsigned reg, void* buf, size_t n);
+
+// Snapshots let a testbench rewind spike after a mismatch and replay the
+// instructions leading up to it, e.g. with difftest_set_trace() on.  They
+// are copy-on-write: taking one copies the hart and device state, and each
+// page of memory is copied only when it is first written afterwards.
+// Instructions are counted over all harts from difftest_init(), and a
+// snapshot covers every hart; writes made through this interface are
+// undone along with those made by the program.
+uint64_t difftest_get_count(void);
+int difftest_snapshot(void);
+// Rewind to the newest snapshot taken at or before instruction count,
+// dropping any later ones, and store the count it was taken at in
+// *restored.  Returns DIFFTEST_ERROR if no such snapshot is kept.
+int difftest_rewind(uint64_t count, uint64_t* restored);
+// Print each instruction executed from now on to stderr.
+void difftest_set_trace(int enable);
+
+// Replay n commit records of hart, each as difftest_step(hart, 1) and
+// difftest_sync_cycle(hart), comparing spike against each one.  Returns
+// DIFFTEST_OK if all of them match; otherwise stops just after the first
+// record that does not, describes it in *mismatch and returns
+// DIFFTEST_MISMATCH.  A DIFFTEST_COMMIT_INTR record stands for an
+// interrupt the DUT took between two instructions.
+int difftest_check_commits(unsigned hart, const difftest_commit_t* commits,
+                           size_t n, difftest_mismatch_t* mismatch);
+
+// Pipelined co-simulation.  Rather than waiting in difftest_check_commits(),
+// a testbench can push its commit records into a ring, from which spike
+// checks them on a worker thread, or in another process that shares the
+// ring's memory, while the DUT simulation carries on.  A mismatch is
+// reported back through the ring's status, some records later.  The ring
+// is a lock-free queue with one producer and one consumer.
+typedef struct {
+  uint32_t hart;
+  uint32_t reserved;
+  difftest_commit_t commit;
+} difftest_ring_entry_t;
+
+typedef struct {
+  // written only by the producer
+  uint64_t head;          // records pushed
+  uint64_t tail_seen;     // tail as last read by the producer
+  uint8_t pad0[48];
+  // written only by the consumer
+  uint64_t tail;          // records checked
+  uint8_t pad1[56];
+  uint64_t size;          // entries, a power of 2
+  int32_t closed;         // producer has pushed its last record
+  int32_t status;         // DIFFTEST_OK, or DIFFTEST_MISMATCH once found, or
+                          // DIFFTEST_ERROR for a record of no such hart
+  uint32_t mismatch_hart;
+  difftest_mismatch_t mismatch;  // index counts records pushed since init
+  difftest_ring_entry_t entry[1];  // size entries in all
+} difftest_ring_t;
+
+// Bytes of memory a ring of size entries needs.
+size_t difftest_ring_bytes(size_t size);
+int difftest_ring_init(difftest_ring_t* ring, size_t size);
+
+// Producer.  Push up to n records of hart, as many as there is room for,
+// and return how many were pushed.
+size_t difftest_ring_push(difftest_ring_t* ring, unsigned hart,
+                          const difftest_commit_t* commits, size_t n);
+void difftest_ring_close(difftest_ring_t* ring);
+// DIFFTEST_OK so far, or DIFFTEST_MISMATCH, with the first mismatch stored
+// in *hart and *mismatch, or DIFFTEST_ERROR for a record of a hart that
+// does not exist, whose hart and index are stored the same way.  The
+// consumer stops at either.
+int difftest_ring_status(difftest_ring_t* ring, unsigned* hart,
+                         difftest_mismatch_t* mismatch);
+
+// Consumer.  Check records until the ring is closed and empty or a record
+// mismatches, and return the ring's status.  No other call may be made
+// into spike meanwhile.
+int difftest_ring_serve(difftest_ring_t* ring);
+// Serve the ring on a new thread, and wait for that thread to finish.
+int difftest_ring_start(difftest_ring_t* ring);
+int difftest_ring_join(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
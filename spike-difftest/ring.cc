@@ -0,0 +1,124 @@
+// See LICENSE for license details.
+
+#include "difftest.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+
+// The consumer publishes its progress this often, so that the producer's
+// cache line is not pulled away on every record.
+#define RING_TAIL_BATCH 64
+// Empty polls before the consumer starts yielding the host CPU.
+#define RING_SPINS 1024
+
+static pthread_t ring_thread;
+static int ring_thread_status;
+
+size_t difftest_ring_bytes(size_t size)
+{
+  return offsetof(difftest_ring_t, entry) + size * sizeof(difftest_ring_entry_t);
+}
+
+int difftest_ring_init(difftest_ring_t* ring, size_t size)
+{
+  if (size == 0 || (size & (size - 1)))
+    return DIFFTEST_ERROR;
+
+  memset(ring, 0, offsetof(difftest_ring_t, entry));
+  ring->size = size;
+  ring->status = DIFFTEST_OK;
+  return DIFFTEST_OK;
+}
+
+size_t difftest_ring_push(difftest_ring_t* ring, unsigned hart,
+                          const difftest_commit_t* commits, size_t n)
+{
+  uint64_t head = ring->head;
+  if (head + n - ring->tail_seen > ring->size)
+    ring->tail_seen = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  n = std::min(n, size_t(ring->size - (head - ring->tail_seen)));
+
+  for (size_t i = 0; i < n; i++) {
+    difftest_ring_entry_t* e = &ring->entry[(head + i) & (ring->size - 1)];
+    e->hart = hart;
+    e->commit = commits[i];
+  }
+
+  __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+  return n;
+}
+
+void difftest_ring_close(difftest_ring_t* ring)
+{
+  __atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+}
+
+int difftest_ring_status(difftest_ring_t* ring, unsigned* hart,
+                         difftest_mismatch_t* mismatch)
+{
+  int status = __atomic_load_n(&ring->status, __ATOMIC_ACQUIRE);
+  if (status != DIFFTEST_OK) {
+    *hart = ring->mismatch_hart;
+    *mismatch = ring->mismatch;
+  }
+  return status;
+}
+
+int difftest_ring_serve(difftest_ring_t* ring)
+{
+  uint64_t tail = ring->tail;
+  unsigned spins = 0;
+
+  while (true) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail == head) {
+      __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+      // closed is set after the last push, so head is final once it is seen
+      if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE) &&
+          __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+        return DIFFTEST_OK;
+      if (++spins > RING_SPINS)
+        sched_yield();
+      continue;
+    }
+    spins = 0;
+
+    for (; tail != head; tail++) {
+      const difftest_ring_entry_t& e = ring->entry[tail & (ring->size - 1)];
+      difftest_mismatch_t mismatch = {};
+      int status = difftest_check_commits(e.hart, &e.commit, 1, &mismatch);
+      if (status != DIFFTEST_OK) {
+        mismatch.index = tail;
+        ring->mismatch = mismatch;
+        ring->mismatch_hart = e.hart;
+        __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&ring->status, status, __ATOMIC_RELEASE);
+        return status;
+      }
+      if ((tail + 1) % RING_TAIL_BATCH == 0)
+        __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+  }
+}
+
+static void* ring_thread_main(void* ring)
+{
+  ring_thread_status = difftest_ring_serve((difftest_ring_t*)ring);
+  return NULL;
+}
+
+int difftest_ring_start(difftest_ring_t* ring)
+{
+  if (pthread_create(&ring_thread, NULL, ring_thread_main, ring) != 0)
+    return DIFFTEST_ERROR;
+  return DIFFTEST_OK;
+}
+
+int difftest_ring_join(void)
+{
+  if (pthread_join(ring_thread, NULL) != 0)
+    return DIFFTEST_ERROR;
+  return ring_thread_status;
+}
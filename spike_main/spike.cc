@@ -4,11 +4,14 @@
 #include "mmu.h"
 #include "remote_bitbang.h"
 #include "cachesim.h"
+#include "coherence.h"
+#include "missprof.h"
 #include "extension.h"
 #include <dlfcn.h>
 #include <fesvr/option_parser.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <string>
 #include <memory>
@@ -34,16 +37,24 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  --varch=<name>        RISC-V Vector uArch string [default %s]\n", DEFAULT_VARCH);
   fprintf(stderr, "  --pc=<address>        Override ELF entry point\n");
   fprintf(stderr, "  --hartids=<a,b,...>   Explicitly specify hartids, default is 0,1,...\n");
-  fprintf(stderr, "  --ic=<S>:<W>:<B>      Instantiate a cache model with S sets,\n");
-  fprintf(stderr, "  --dc=<S>:<W>:<B>        W ways, and B-byte blocks (with S and\n");
-  fprintf(stderr, "  --l2=<S>:<W>:<B>        B both powers of 2).\n");
+  fprintf(stderr, "  --ic=<S>:<W>:<B>[:<P>]\n");
+  fprintf(stderr, "  --dc=<S>:<W>:<B>[:<P>]\n");
+  fprintf(stderr, "  --l2=<S>:<W>:<B>[:<P>]\n");
+  fprintf(stderr, "                        Instantiate a cache model with S sets, W ways, and B-byte\n");
+  fprintf(stderr, "                        blocks (with S and B both powers of 2), replacing lines by\n");
+  fprintf(stderr, "                        policy P: random [default], lru, plru or srrip\n");
+  fprintf(stderr, "  --private-l1          Give each processor its own I$ and D$, kept coherent by a MESI directory\n");
+  fprintf(stderr, "  --l2-inclusive        Keep the L2$ inclusive of the L1 caches\n");
   fprintf(stderr, "  --device=<P,B,A>      Attach MMIO plugin device from an --extlib library\n");
   fprintf(stderr, "                          P -- Name of the MMIO plugin\n");
   fprintf(stderr, "                          B -- Base memory address of the device\n");
   fprintf(stderr, "                          A -- String arguments to pass to the plugin\n");
   fprintf(stderr, "                          This flag can be used multiple times.\n");
   fprintf(stderr, "                          The extlib flag for the library must come first.\n");
+  fprintf(stderr, "  --miss-profile=<n>    Print the n PCs, regions and pages with the most misses in each cache\n");
+  fprintf(stderr, "  --miss-profile-csv=<file>  Write all of them to file as CSV\n");
   fprintf(stderr, "  --log-cache-miss      Generate a log of cache miss\n");
+  fprintf(stderr, "  --shared-decode-cache Share one physically-indexed decode cache among harts\n");
   fprintf(stderr, "  --extension=<name>    Specify RoCC Extension\n");
   fprintf(stderr, "  --extlib=<name>       Shared library to load\n");
   fprintf(stderr, "                        This flag can be used multiple times.\n");
@@ -54,6 +65,25 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  --initrd=<path>       Load kernel initrd into memory\n");
   fprintf(stderr, "  --bootargs=<args>     Provide custom bootargs for kernel [default: console=hvc0 earlycon=sbi]\n");
   fprintf(stderr, "  --real-time-clint     Increment clint time at real-time rate\n");
+  fprintf(stderr, "  --checkpoint-save=<file>@<n>\n");
+  fprintf(stderr, "                        Save a checkpoint once hart 0 has retired n instructions\n");
+  fprintf(stderr, "  --checkpoint-every=<n> Then save one every n instructions to <file>.1, <file>.2, ...\n");
+  fprintf(stderr, "                        each of the pages stored to since the one before\n");
+  fprintf(stderr, "  --checkpoint-restore=<file>\n");
+  fprintf(stderr, "                        Start from a checkpoint saved with the same options\n");
+  fprintf(stderr, "  --checkpoint-export=<prefix>\n");
+  fprintf(stderr, "                        Also write the checkpoint as a boot image for RTL simulation:\n");
+  fprintf(stderr, "                        <prefix>-rom.bin, to load at the reset vector, and\n");
+  fprintf(stderr, "                        <prefix>-<base>.bin for each memory\n");
+  fprintf(stderr, "  --bbv=<n>             Write SimPoint basic block vectors of every n instructions\n");
+  fprintf(stderr, "  --bbv-file=<file>     Write them to <file>, or <file>.<hart> with -p [default spike.bb]\n");
+  fprintf(stderr, "  --detail-start=<trigger>\n");
+  fprintf(stderr, "                        Fast-forward, without cache models or logs, until <trigger>:\n");
+  fprintf(stderr, "                        instret:<n>, pc:<address> or marker (slti x0, x0, 1)\n");
+  fprintf(stderr, "  --detail-stop=<trigger>\n");
+  fprintf(stderr, "                        Fast-forward again from <trigger> (marker: slti x0, x0, 2)\n");
+  fprintf(stderr, "  --sample=<p>:<w>:<n>  Of every p instructions, fast-forward all but the last w + n,\n");
+  fprintf(stderr, "                        warm up the cache models over w and measure them over n\n");
   fprintf(stderr, "  --dm-progsize=<words> Progsize for the debug module [default 2]\n");
   fprintf(stderr, "  --dm-sba=<bits>       Debug bus master supports up to "
       "<bits> wide accesses [default 0]\n");
@@ -191,6 +221,13 @@ int main(int argc, char** argv)
   bool dump_dts = false;
   bool dtb_enabled = true;
   bool real_time_clint = false;
+  std::string checkpoint_save, checkpoint_restore, checkpoint_export;
+  reg_t checkpoint_save_instret = 0;
+  reg_t checkpoint_every = 0;
+  reg_t bbv_interval = 0;
+  std::string bbv_file = "spike.bb";
+  detail_trigger_t detail_start, detail_stop;
+  reg_t sample_period = 0, sample_warmup = 0, sample_window = 0;
   size_t nprocs = 1;
   const char* kernel = NULL;
   reg_t kernel_offset, kernel_size;
@@ -200,10 +237,20 @@ int main(int argc, char** argv)
   reg_t start_pc = reg_t(-1);
   std::vector<std::pair<reg_t, mem_t*>> mems;
   std::vector<std::pair<reg_t, abstract_device_t*>> plugin_devices;
-  std::unique_ptr<icache_sim_t> ic;
-  std::unique_ptr<dcache_sim_t> dc;
+  const char* ic_config = NULL;
+  const char* dc_config = NULL;
+  bool private_l1 = false;
+  bool l2_inclusive = false;
+  size_t miss_profile_rows = 0;
+  std::string miss_profile_csv;
+  std::unique_ptr<miss_profile_t> miss_profile;
+  std::vector<std::unique_ptr<miss_profile_tracer_t>> miss_profile_tracers;
+  std::unique_ptr<coherence_t> coherence;
+  std::vector<std::unique_ptr<icache_sim_t>> ics;
+  std::vector<std::unique_ptr<dcache_sim_t>> dcs;
   std::unique_ptr<cache_sim_t> l2;
   bool log_cache = false;
+  bool shared_decode_cache = false;
   bool log_commits = false;
   const char *log_path = nullptr;
   std::function<extension_t*()> extension;
@@ -295,10 +342,15 @@ int main(int argc, char** argv)
   parser.option(0, "rbb-port", 1, [&](const char* s){use_rbb = true; rbb_port = atoi(s);});
   parser.option(0, "pc", 1, [&](const char* s){start_pc = strtoull(s, 0, 0);});
   parser.option(0, "hartids", 1, hartids_parser);
-  parser.option(0, "ic", 1, [&](const char* s){ic.reset(new icache_sim_t(s));});
-  parser.option(0, "dc", 1, [&](const char* s){dc.reset(new dcache_sim_t(s));});
+  parser.option(0, "ic", 1, [&](const char* s){ic_config = s;});
+  parser.option(0, "dc", 1, [&](const char* s){dc_config = s;});
   parser.option(0, "l2", 1, [&](const char* s){l2.reset(cache_sim_t::construct(s, "L2$"));});
+  parser.option(0, "private-l1", 0, [&](const char* s){private_l1 = true;});
+  parser.option(0, "l2-inclusive", 0, [&](const char* s){l2_inclusive = true;});
+  parser.option(0, "miss-profile", 1, [&](const char* s){miss_profile_rows = atoi(s);});
+  parser.option(0, "miss-profile-csv", 1, [&](const char* s){miss_profile_csv = s;});
   parser.option(0, "log-cache-miss", 0, [&](const char* s){log_cache = true;});
+  parser.option(0, "shared-decode-cache", 0, [&](const char* s){shared_decode_cache = true;});
   parser.option(0, "isa", 1, [&](const char* s){isa = s;});
   parser.option(0, "priv", 1, [&](const char* s){priv = s;});
   parser.option(0, "varch", 1, [&](const char* s){varch = s;});
@@ -311,6 +363,38 @@ int main(int argc, char** argv)
   parser.option(0, "initrd", 1, [&](const char* s){initrd = s;});
   parser.option(0, "bootargs", 1, [&](const char* s){bootargs = s;});
   parser.option(0, "real-time-clint", 0, [&](const char *s){real_time_clint = true;});
+  parser.option(0, "checkpoint-save", 1, [&](const char* s){
+    const char* at = strrchr(s, '@');
+    if (!at)
+      help();
+    checkpoint_save = std::string(s, at);
+    checkpoint_save_instret = strtoull(at + 1, 0, 0);
+  });
+  parser.option(0, "checkpoint-every", 1, [&](const char* s){checkpoint_every = strtoull(s, 0, 0);});
+  parser.option(0, "checkpoint-restore", 1, [&](const char* s){checkpoint_restore = s;});
+  parser.option(0, "checkpoint-export", 1, [&](const char* s){checkpoint_export = s;});
+  parser.option(0, "bbv", 1, [&](const char* s){bbv_interval = strtoull(s, 0, 0);});
+  parser.option(0, "bbv-file", 1, [&](const char* s){bbv_file = s;});
+  parser.option(0, "detail-start", 1, [&](const char* s){
+    if (!detail_start.parse(s))
+      help();
+  });
+  parser.option(0, "detail-stop", 1, [&](const char* s){
+    if (!detail_stop.parse(s))
+      help();
+  });
+  parser.option(0, "sample", 1, [&](const char* s){
+    char* end;
+    sample_period = strtoull(s, &end, 0);
+    if (*end != ':')
+      help();
+    sample_warmup = strtoull(end + 1, &end, 0);
+    if (*end != ':')
+      help();
+    sample_window = strtoull(end + 1, &end, 0);
+    if (*end != 0)
+      help();
+  });
   parser.option(0, "extlib", 1, [&](const char *s){
     void *lib = dlopen(s, RTLD_NOW | RTLD_GLOBAL);
     if (lib == NULL) {
@@ -391,22 +475,113 @@ int main(int argc, char** argv)
     return 0;
   }
 
-  if (ic && l2) ic->set_miss_handler(&*l2);
-  if (dc && l2) dc->set_miss_handler(&*l2);
-  if (ic) ic->set_log(log_cache);
-  if (dc) dc->set_log(log_cache);
+  if (l2_inclusive && !l2)
+    help();
+  try {
+    if (private_l1 || l2_inclusive)
+      coherence.reset(new coherence_t);
+    for (size_t i = 0; i < (private_l1 ? nprocs : 1); i++) {
+      std::string suffix = private_l1 ? std::to_string(i) : "";
+      if (ic_config)
+        ics.emplace_back(new icache_sim_t(ic_config, ("I$" + suffix).c_str()));
+      if (dc_config)
+        dcs.emplace_back(new dcache_sim_t(dc_config, ("D$" + suffix).c_str()));
+    }
+    for (auto& ic : ics) {
+      if (l2) ic->set_miss_handler(&*l2);
+      if (coherence) ic->get_cache()->set_coherence(coherence.get());
+      ic->set_log(log_cache);
+    }
+    for (auto& dc : dcs) {
+      if (l2) dc->set_miss_handler(&*l2);
+      if (coherence) dc->get_cache()->set_coherence(coherence.get());
+      dc->set_log(log_cache);
+    }
+  } catch (std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  if (l2_inclusive)
+    l2->set_inclusive_of(coherence.get());
+  if (miss_profile_rows || !miss_profile_csv.empty()) {
+    miss_profile.reset(new miss_profile_t(miss_profile_rows, miss_profile_csv));
+    for (auto& ic : ics)
+      miss_profile->add_cache(ic->get_cache());
+    for (auto& dc : dcs)
+      miss_profile->add_cache(dc->get_cache());
+    if (l2) miss_profile->add_cache(&*l2);
+  }
+  bool detail = detail_start.kind != detail_trigger_t::NONE ||
+                detail_stop.kind != detail_trigger_t::NONE;
+  std::unique_ptr<sampler_t> sampler;
+  if (sample_period) {
+    if (detail)
+      help();
+    try {
+      sampler.reset(new sampler_t(sample_period, sample_warmup, sample_window));
+    } catch (std::exception& e) {
+      fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+    for (auto& ic : ics)
+      sampler->add_cache(ic->get_cache());
+    for (auto& dc : dcs)
+      sampler->add_cache(dc->get_cache());
+    if (l2) sampler->add_cache(&*l2);
+    detail = true;
+  }
   for (size_t i = 0; i < nprocs; i++)
   {
-    if (ic) s.get_core(i)->get_mmu()->register_memtracer(&*ic);
-    if (dc) s.get_core(i)->get_mmu()->register_memtracer(&*dc);
+    std::vector<memtracer_t*> tracers;
+    if (!ics.empty()) tracers.push_back(ics[private_l1 ? i : 0].get());
+    if (!dcs.empty()) tracers.push_back(dcs[private_l1 ? i : 0].get());
+    if (miss_profile && !tracers.empty()) {
+      miss_profile_tracers.emplace_back(
+          new miss_profile_tracer_t(miss_profile.get(), s.get_core(i)));
+      for (memtracer_t* t : tracers)
+        miss_profile_tracers.back()->list.hook(t);
+      tracers.assign(1, miss_profile_tracers.back().get());
+    }
+    for (memtracer_t* t : tracers) {
+      if (detail)
+        s.add_detail_tracer(i, t);
+      else
+        s.get_core(i)->get_mmu()->register_memtracer(t);
+    }
     if (extension) s.get_core(i)->register_extension(extension());
   }
+  if (shared_decode_cache) s.set_shared_decode_cache(true);
 
   s.set_debug(debug);
   s.configure_log(log, log_commits);
+  if (sampler)
+    s.set_sampler(sampler.get());
+  else if (detail)
+    s.set_detail_triggers(detail_start, detail_stop);
   s.set_histogram(histogram);
+  if (checkpoint_every && checkpoint_save.empty())
+    help();
+  if (!checkpoint_save.empty())
+    s.set_checkpoint_save(checkpoint_save, checkpoint_save_instret, checkpoint_every);
+  if (!checkpoint_restore.empty())
+    s.set_checkpoint_restore(checkpoint_restore);
+  if (!checkpoint_export.empty()) {
+    if (checkpoint_save.empty() && checkpoint_restore.empty())
+      help();
+    s.set_checkpoint_export(checkpoint_export);
+  }
+  if (bbv_interval) {
+    try {
+      s.set_bbv(bbv_file, bbv_interval);
+    } catch (std::exception& e) {
+      fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+  }
 
   auto return_code = s.run();
+  if (miss_profile)
+    miss_profile->set_symbols(s.get_symbols());
 
   for (auto& mem : mems)
     delete mem.second;